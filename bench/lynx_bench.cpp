@@ -0,0 +1,285 @@
+/* Headless throughput benchmark for the Lynx core.
+ *
+ * Links the core objects directly, loads a ROM through retro_load_game()
+ * and drives retro_run() with callbacks that discard video and audio.
+ * Reports frames/sec, emulated master cycles/sec and per-frame latency
+ * percentiles, plus CRCs of the produced video/audio so a behavioural
+ * change shows up next to a performance one.
+ *
+ *    make bench
+ *    ./mednafen_lynx_bench [-n frames] [-w warmup] [-s system_dir] [-d 16|32] rom
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <libretro.h>
+#include "../libretro_lynx.h"
+#include "../scrc32.h"
+
+static const char *system_dir = ".";
+static const char *pix_format = "16";
+static bool verbose;
+
+static unsigned video_bpp = 16;
+static uint32_t video_crc;
+static uint32_t audio_crc;
+static uint64_t audio_frames;
+
+static uint64_t now_ns(void)
+{
+#ifdef _WIN32
+   LARGE_INTEGER freq, count;
+   QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&count);
+   return (uint64_t)((double)count.QuadPart * 1000000000.0 / (double)freq.QuadPart);
+#else
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static void bench_log(enum retro_log_level level, const char *fmt, ...)
+{
+   va_list ap;
+
+   if (!verbose && level < RETRO_LOG_WARN)
+      return;
+
+   va_start(ap, fmt);
+   vfprintf(stderr, fmt, ap);
+   va_end(ap);
+}
+
+static bool bench_environment(unsigned cmd, void *data)
+{
+   switch (cmd)
+   {
+      case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+         ((struct retro_log_callback*)data)->log = bench_log;
+         return true;
+      case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+         *(const char**)data = system_dir;
+         return true;
+      case RETRO_ENVIRONMENT_GET_VARIABLE:
+         {
+            struct retro_variable *var = (struct retro_variable*)data;
+            if (!strcmp(var->key, "lynx_pix_format"))
+            {
+               var->value = pix_format;
+               return true;
+            }
+         }
+         return false;
+      case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+         video_bpp = *(const enum retro_pixel_format*)data == RETRO_PIXEL_FORMAT_XRGB8888 ? 32 : 16;
+         return true;
+      case RETRO_ENVIRONMENT_GET_CAN_DUPE:
+         *(bool*)data = true;
+         return true;
+      default:
+         break;
+   }
+   return false;
+}
+
+static void bench_video(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+   const uint8_t *row = (const uint8_t*)data;
+
+   if (!data)
+      return;
+
+   for (unsigned y = 0; y < height; y++, row += pitch)
+      video_crc = crc32(video_crc, row, width * (video_bpp / 8));
+}
+
+static size_t bench_audio_batch(const int16_t *data, size_t frames)
+{
+   audio_crc     = crc32(audio_crc, (const uint8_t*)data, frames * 2 * sizeof(int16_t));
+   audio_frames += frames;
+   return frames;
+}
+
+static void bench_audio(int16_t left, int16_t right)
+{
+}
+
+static void bench_input_poll(void)
+{
+}
+
+static int16_t bench_input_state(unsigned port, unsigned device, unsigned index, unsigned id)
+{
+   return 0;
+}
+
+static bool load_file(const char *path, std::vector<uint8_t> &out)
+{
+   FILE *fp = fopen(path, "rb");
+   long size;
+
+   if (!fp)
+      return false;
+
+   fseek(fp, 0, SEEK_END);
+   size = ftell(fp);
+   fseek(fp, 0, SEEK_SET);
+
+   out.resize(size > 0 ? size : 0);
+   if (size > 0 && fread(&out[0], 1, size, fp) != (size_t)size)
+   {
+      fclose(fp);
+      return false;
+   }
+
+   fclose(fp);
+   return true;
+}
+
+static void usage(const char *argv0)
+{
+   fprintf(stderr,
+         "Usage: %s [-n frames] [-w warmup] [-s system_dir] [-d 16|32] [-v] rom\n"
+         "  -n  measured frames (default 3000)\n"
+         "  -w  unmeasured warm-up frames (default 60)\n"
+         "  -s  directory holding lynxboot.img (default .)\n"
+         "  -d  output colour depth (default 16)\n"
+         "  -v  show core log output\n", argv0);
+}
+
+static double percentile(const std::vector<uint64_t> &sorted, double p)
+{
+   size_t idx = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+   return (double)sorted[idx] / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+   unsigned frames = 3000;
+   unsigned warmup = 60;
+   const char *rom_path = NULL;
+   std::vector<uint8_t> rom;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "-n") && i + 1 < argc)
+         frames = strtoul(argv[++i], NULL, 0);
+      else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+         warmup = strtoul(argv[++i], NULL, 0);
+      else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+         system_dir = argv[++i];
+      else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+         pix_format = argv[++i];
+      else if (!strcmp(argv[i], "-v"))
+         verbose = true;
+      else if (argv[i][0] != '-' && !rom_path)
+         rom_path = argv[i];
+      else
+      {
+         usage(argv[0]);
+         return 1;
+      }
+   }
+
+   if (!rom_path || !frames)
+   {
+      usage(argv[0]);
+      return 1;
+   }
+
+   if (!load_file(rom_path, rom) || rom.empty())
+   {
+      fprintf(stderr, "Could not read ROM \"%s\".\n", rom_path);
+      return 1;
+   }
+
+   retro_set_environment(bench_environment);
+   retro_set_video_refresh(bench_video);
+   retro_set_audio_sample(bench_audio);
+   retro_set_audio_sample_batch(bench_audio_batch);
+   retro_set_input_poll(bench_input_poll);
+   retro_set_input_state(bench_input_state);
+   retro_init();
+
+   struct retro_game_info info;
+   memset(&info, 0, sizeof(info));
+   info.path = rom_path;
+   info.data = &rom[0];
+   info.size = rom.size();
+
+   if (!retro_load_game(&info))
+   {
+      fprintf(stderr, "retro_load_game() failed for \"%s\".\n", rom_path);
+      retro_deinit();
+      return 1;
+   }
+
+   for (unsigned i = 0; i < warmup; i++)
+      retro_run();
+
+   video_crc    = 0;
+   audio_crc    = 0;
+   audio_frames = 0;
+
+   std::vector<uint64_t> frame_ns(frames);
+   struct lynx_perf_stats perf[16];
+   uint64_t perf_ticks[16] = {0};
+   unsigned perf_count = 0;
+   uint64_t cycles = 0;
+   uint64_t start  = now_ns();
+
+   for (unsigned i = 0; i < frames; i++)
+   {
+      uint64_t t0 = now_ns();
+      retro_run();
+      frame_ns[i] = now_ns() - t0;
+      cycles     += lynx_get_frame_cycles();
+
+      perf_count = lynx_perf_get_frame_stats(perf, 16);
+      for (unsigned j = 0; j < perf_count; j++)
+         perf_ticks[j] += perf[j].ticks;
+   }
+
+   double elapsed = (double)(now_ns() - start) / 1e9;
+
+   retro_unload_game();
+   retro_deinit();
+
+   std::sort(frame_ns.begin(), frame_ns.end());
+
+   printf("rom:           %s\n", rom_path);
+   printf("frames:        %u (+%u warm-up), %ubpp\n", frames, warmup, video_bpp);
+   printf("elapsed:       %.3f s\n", elapsed);
+   printf("fps:           %.1f (%.2fx realtime)\n", frames / elapsed, frames / elapsed / 75.0);
+   printf("cycles/sec:    %.2f M (%llu master cycles)\n", cycles / elapsed / 1e6, (unsigned long long)cycles);
+   printf("frame us:      p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+         percentile(frame_ns, 0.50), percentile(frame_ns, 0.90),
+         percentile(frame_ns, 0.99), percentile(frame_ns, 1.0));
+   printf("video crc:     %08x\n", video_crc);
+   printf("audio crc:     %08x (%llu frames)\n", audio_crc, (unsigned long long)audio_frames);
+
+   if (perf_count)
+   {
+      uint64_t total = 0;
+      for (unsigned j = 0; j < perf_count; j++)
+         total += perf_ticks[j];
+
+      for (unsigned j = 0; j < perf_count && total; j++)
+         printf("  %-16s %5.1f%%  %.0f ticks/frame\n", perf[j].ident,
+               100.0 * perf_ticks[j] / total, (double)perf_ticks[j] / frames);
+   }
+
+   return 0;
+}
@@ -9,11 +9,19 @@
 #include <algorithm>
 #include "mednafen/lynx/system.h"
 #include "libretro_core_options.h"
+#include "libretro_lynx.h"
+#include "lynx_rewind.h"
 
 #ifdef _MSC_VER
 #include <compat/msvc.h>
 #endif
 
+/* Older libretro.h headers don't have the savestate context yet */
+#ifndef RETRO_ENVIRONMENT_GET_SAVESTATE_CONTEXT
+#define RETRO_ENVIRONMENT_GET_SAVESTATE_CONTEXT (72 | RETRO_ENVIRONMENT_EXPERIMENTAL)
+#define RETRO_SAVESTATE_CONTEXT_NORMAL 0
+#endif
+
 #ifdef _WIN32
 static char slash = '\\';
 #else
@@ -41,6 +49,7 @@ static unsigned rotate_screen_last_frame;
 static unsigned select_pressed_last_frame;
 
 static MDFN_Surface *surf;
+static uint32_t frame_cycles;
 
 static bool failed_init;
 
@@ -53,6 +62,28 @@ static char retro_system_directory[4096];
 static bool libretro_supports_input_bitmasks;
 static int system_color_depth = 16;
 
+/* The state layout only depends on the loaded game */
+static size_t serialize_size;
+static size_t compact_size;
+static StateLayouts state_layouts;
+
+/* retro_run() calls since the frontend last saved a state for run-ahead or
+ * rollback.  While it does, the frames it keeps are the ones it saves and
+ * rewind records those, see retro_serialize(). */
+#define REWIND_CONTEXT_FRAMES 16
+static unsigned frames_since_context_save = REWIND_CONTEXT_FRAMES;
+
+/* Frames the picture is run ahead of the machine, 0 when disabled */
+static unsigned run_ahead;
+static lynx_snapshot_t *run_ahead_slot;
+
+/* The frame is left as the captured lines, see lynx_set_raw_video() */
+static bool raw_video;
+
+/* Frames identical to the one the frontend has are passed on as dupes */
+static bool can_dupe;
+static bool frame_shown;
+
 extern MDFNGI EmulatedLynx;
 MDFNGI *MDFNGameInfo = &EmulatedLynx;
 
@@ -97,6 +128,10 @@ void retro_init(void)
    else
       perf_get_cpu_features_cb = NULL;
 
+#ifdef WANT_PERF_COUNTERS
+   PerfRegister(&perf_cb);
+#endif
+
    check_system_specs();
 
    libretro_set_core_options(environ_cb);
@@ -167,6 +202,16 @@ static void check_variables(void)
          rotate_fixed  = 3;
       }
    }
+
+   var.key = "lynx_run_ahead";
+   var.value = NULL;
+
+   run_ahead = 0;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (strcmp(var.value, "disabled") != 0)
+         run_ahead = atoi(var.value);
+   }
 }
 
 #define MAX_PLAYERS 1
@@ -271,6 +316,10 @@ bool retro_load_game(const struct retro_game_info *info)
 
    environ_cb(RETRO_ENVIRONMENT_SET_INPUT_DESCRIPTORS, desc);
 
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &can_dupe))
+      can_dupe = false;
+   frame_shown = false;
+
    overscan = false;
    environ_cb(RETRO_ENVIRONMENT_GET_OVERSCAN, &overscan);
 
@@ -325,6 +374,14 @@ static void MDFNI_CloseGame(void)
    MDFNMP_Kill();
 
    MDFNGameInfo = NULL;
+   lynx_snapshot_destroy(run_ahead_slot);
+   run_ahead_slot = NULL;
+
+   serialize_size = 0;
+   compact_size = 0;
+   frames_since_context_save = REWIND_CONTEXT_FRAMES;
+   state_layouts.count = 0;
+   lynx_rewind_reset();
 }
 
 
@@ -442,20 +499,56 @@ static void update_input(void)
    rotate_screen_last_frame  = rotate_screen;
 }
 
-void retro_run()
+/* Points 'out' at the frontend's framebuffer when it has one the frame can
+ * be drawn into directly, saving the frontend a copy.  'pitch' is set to
+ * its pitch in bytes. */
+static bool get_frontend_surface(MDFN_Surface *out, size_t *pitch)
 {
-   input_poll_cb();
+   struct retro_framebuffer fb = {0};
+   unsigned bytes = system_color_depth >> 3;
+   enum retro_pixel_format format = system_color_depth == 32 ?
+      RETRO_PIXEL_FORMAT_XRGB8888 : RETRO_PIXEL_FORMAT_RGB565;
 
-   update_input();
+   fb.width        = FB_WIDTH;
+   fb.height       = FB_HEIGHT;
+   fb.access_flags = RETRO_MEMORY_ACCESS_WRITE;
+
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, &fb))
+      return false;
+
+   if (!fb.data || fb.format != format || fb.width < FB_WIDTH ||
+         fb.height < FB_HEIGHT || fb.pitch < FB_WIDTH * bytes || fb.pitch % bytes)
+      return false;
+
+   *out        = *surf;
+   out->pixels = (uint16*)fb.data;
+   out->pitch  = fb.pitch / bytes;
+   *pitch      = fb.pitch;
+   return true;
+}
 
+/* Runs one frame with the input already set, making the video and audio
+ * callbacks only for what is enabled. */
+static void run_frame(bool video_enable, bool audio_enable)
+{
    static int16_t sound_buf[0x10000];
    static MDFN_Rect rects[FB_MAX_HEIGHT];
    rects[0].w = ~0;
 
+   MDFN_Surface frontend_surf;
+   MDFN_Surface *target = surf;
+   size_t pitch = FB_WIDTH << (system_color_depth >> 4);
+
+   if (video_enable && !raw_video && get_frontend_surface(&frontend_surf, &pitch))
+      target = &frontend_surf;
+
    EmulateSpecStruct spec = {0};
-   spec.surface = surf;
+   spec.surface = target;
+   spec.skip = !video_enable;
+   spec.raw_video = raw_video;
+   spec.CanDupe = can_dupe && frame_shown && !raw_video;
    spec.SoundRate = 44100;
-   spec.SoundBuf = sound_buf;
+   spec.SoundBuf = audio_enable ? sound_buf : NULL;
    spec.LineWidths = rects;
    spec.SoundBufMaxSize = sizeof(sound_buf) / 2;
    spec.SoundVolume = 1.0;
@@ -480,15 +573,218 @@ void retro_run()
 
    unsigned width  = spec.DisplayRect.w;
    unsigned height = spec.DisplayRect.h;
-   unsigned pitch  = FB_WIDTH << (system_color_depth >> 4);
 
-   video_cb(surf->pixels, width, height, pitch);
+   if (video_enable && raw_video)
+      frame_shown = false;
+   else if (video_enable)
+   {
+      video_cb(spec.VideoUnchanged ? NULL : target->pixels, width, height, pitch);
+      frame_shown = true;
+   }
 
-   audio_batch_cb(spec.SoundBuf, spec.SoundBufSize);
+   if (audio_enable)
+      audio_batch_cb(spec.SoundBuf, spec.SoundBufSize);
+
+   frame_cycles = spec.MasterCycles;
+}
+
+/* Run-ahead: the frame the input belongs to is run for its sound only and
+ * saved, then the frames after it are run with neither video nor sound and
+ * the last of them shown, and the saved frame is loaded back.  The picture
+ * is 'run_ahead' frames ahead of the machine, which removes as many frames
+ * of the game's own input lag. */
+static void run_ahead_frames(bool audio_enable)
+{
+   uint32_t cycles;
+
+   if (!run_ahead_slot)
+      run_ahead_slot = lynx_snapshot_create();
+
+   if (!run_ahead_slot)
+   {
+      run_frame(true, audio_enable);
+      return;
+   }
+
+   run_frame(false, audio_enable);
+   cycles = frame_cycles;
+
+   lynx_snapshot_save(run_ahead_slot);
+#ifdef WANT_DIRTY_PAGES
+   /* Loading the snapshot marks every page, and the frames run ahead are
+    * undone by it, so the pages written by the real frame are put back */
+   uint8_t dirty[RAM_PAGES];
+   memcpy(dirty, lynxie->GetDirtyPages(), RAM_PAGES);
+#endif
+
+   for (unsigned i = 1; i < run_ahead; i++)
+      run_frame(false, false);
+   run_frame(true, false);
+
+   lynx_snapshot_load(run_ahead_slot);
+#ifdef WANT_DIRTY_PAGES
+   memcpy(lynxie->GetDirtyPages(), dirty, RAM_PAGES);
+#endif
+   frame_cycles = cycles;
+}
+
+void retro_run()
+{
+   PERF_START(PERF_FRAME);
+
+   input_poll_cb();
+
+   update_input();
+
+   /* Frames run again for rollback or run-ahead skip the video and audio
+    * output, the emulated machine behaves the same either way. */
+   int av_enable = 3;
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &av_enable))
+      av_enable = 3;
+   bool video_enable = av_enable & 1;
+   bool audio_enable = av_enable & 2;
+
+   /* No point running ahead for a frame that isn't shown */
+   if (run_ahead && video_enable)
+      run_ahead_frames(audio_enable);
+   else
+      run_frame(video_enable, audio_enable);
 
    bool updated = false;
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
       check_variables();
+
+   if (frames_since_context_save < REWIND_CONTEXT_FRAMES)
+      frames_since_context_save++;
+   else
+      lynx_rewind_push();
+
+   PERF_STOP(PERF_FRAME);
+#ifdef WANT_PERF_COUNTERS
+   PerfEndFrame();
+#endif
+}
+
+uint32_t lynx_get_frame_cycles(void)
+{
+   return frame_cycles;
+}
+
+unsigned lynx_perf_get_frame_stats(struct lynx_perf_stats *stats, unsigned max)
+{
+#ifdef WANT_PERF_COUNTERS
+   for (unsigned i = 0; i < max && i < PERF_COUNTERS; i++)
+   {
+      stats[i].ident = gPerfCounters[i].counter.ident;
+      stats[i].ticks = gPerfCounters[i].frame_total;
+      stats[i].calls = gPerfCounters[i].frame_calls;
+   }
+   return PERF_COUNTERS;
+#else
+   return 0;
+#endif
+}
+
+struct lynx_snapshot
+{
+   size_t size;
+   uint8_t *data;
+};
+
+lynx_snapshot_t *lynx_snapshot_create(void)
+{
+   lynx_snapshot_t *snapshot;
+   size_t size = lynx_state_size(true);
+
+   if (!size)
+      return NULL;
+
+   snapshot = (lynx_snapshot_t*)malloc(sizeof(*snapshot));
+   if (!snapshot)
+      return NULL;
+
+   snapshot->size = size;
+   snapshot->data = (uint8_t*)malloc(size);
+   if (!snapshot->data)
+   {
+      free(snapshot);
+      return NULL;
+   }
+
+   return snapshot;
+}
+
+void lynx_snapshot_destroy(lynx_snapshot_t *snapshot)
+{
+   if (!snapshot)
+      return;
+
+   free(snapshot->data);
+   free(snapshot);
+}
+
+bool lynx_snapshot_save(lynx_snapshot_t *snapshot)
+{
+   return lynx_state_save(snapshot->data, snapshot->size, true);
+}
+
+bool lynx_snapshot_load(const lynx_snapshot_t *snapshot)
+{
+   return retro_unserialize(snapshot->data, snapshot->size);
+}
+
+unsigned lynx_get_dirty_pages(uint8_t pages[256])
+{
+#ifdef WANT_DIRTY_PAGES
+   unsigned count = 0;
+
+   if (lynxie)
+   {
+      memcpy(pages, lynxie->GetDirtyPages(), RAM_PAGES);
+      for (unsigned i = 0; i < RAM_PAGES; i++)
+         count += pages[i] != 0;
+      return count;
+   }
+#endif
+   memset(pages, 1, 256);
+   return 256;
+}
+
+void lynx_clear_dirty_pages(void)
+{
+#ifdef WANT_DIRTY_PAGES
+   if (lynxie)
+      memset(lynxie->GetDirtyPages(), 0, RAM_PAGES);
+#endif
+}
+
+void lynx_set_raw_video(bool enable)
+{
+   raw_video = enable;
+}
+
+unsigned lynx_get_raw_frame(struct lynx_raw_line lines[LYNX_RAW_HEIGHT])
+{
+   unsigned count = 0;
+
+   for (unsigned i = 0; i < LYNX_RAW_HEIGHT; i++)
+   {
+      if (lynxie && lynxie->mMikie->mLineDrawn[i])
+      {
+         lines[i].pens    = lynxie->mMikie->GetLinePens(i);
+         lines[i].palette = lynxie->mMikie->GetLinePalette(i);
+         lines[i].flip    = lynxie->mMikie->GetLineFlip(i);
+         count++;
+      }
+      else
+      {
+         lines[i].pens    = NULL;
+         lines[i].palette = NULL;
+         lines[i].flip    = false;
+      }
+   }
+
+   return count;
 }
 
 void retro_get_system_info(struct retro_system_info *info)
@@ -583,56 +879,80 @@ void retro_set_video_refresh(retro_video_refresh_t cb)
    video_cb = cb;
 }
 
-static size_t serialize_size;
-
-size_t retro_serialize_size(void)
+size_t lynx_state_size(bool compact)
 {
+   size_t *size = compact ? &compact_size : &serialize_size;
    StateMem st;
 
-   st.data           = NULL;
-   st.loc            = 0;
-   st.len            = 0;
-   st.malloced       = 0;
-   st.initial_malloc = 0;
+   if (*size)
+      return *size;
 
-   if (!MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL))
-      return 0;
+   /* A fixed buffer with no room, the save only counts the bytes */
+   memset(&st, 0, sizeof(st));
+   st.fixed   = 1;
+   st.compact = compact;
+   st.layouts = &state_layouts;
 
-   free(st.data);
+   MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL);
 
-   return serialize_size = st.len;
+   return *size = st.len;
 }
 
-bool retro_serialize(void *data, size_t size)
+bool lynx_state_save(void *data, size_t size, bool compact)
 {
    StateMem st;
-   bool ret          = false;
-   uint8_t *_dat     = (uint8_t*)malloc(size);
 
-   if (!_dat)
+   memset(&st, 0, sizeof(st));
+   st.data     = (uint8_t*)data;
+   st.malloced = size;
+   st.fixed    = 1;
+   st.compact  = compact;
+   st.layouts  = &state_layouts;
+
+   return MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL);
+}
+
+/* A compact state can only be loaded by the build that wrote it.  States
+ * the frontend keeps for run-ahead or netplay rollback never outlive it,
+ * any other state is saved in the named format. */
+static bool frontend_state_compact(void)
+{
+   int context = RETRO_SAVESTATE_CONTEXT_NORMAL;
+
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_SAVESTATE_CONTEXT, &context))
       return false;
 
-   /* Mednafen can realloc the buffer so we need to ensure this is safe. */
-   st.data           = _dat;
-   st.loc            = 0;
-   st.len            = 0;
-   st.malloced       = size;
-   st.initial_malloc = 0;
+   return context != RETRO_SAVESTATE_CONTEXT_NORMAL;
+}
 
-   ret = MDFNSS_SaveSM(&st, 0, 0, NULL, NULL, NULL);
+/* The named format is the larger one, the buffer fits either */
+size_t retro_serialize_size(void)
+{
+   return lynx_state_size(false);
+}
+
+bool retro_serialize(void *data, size_t size)
+{
+   bool compact = frontend_state_compact();
 
-   memcpy(data, st.data, size);
-   free(st.data);
+   /* Frames run ahead and undone again aren't saved, so the real frames
+    * are recorded here rather than at the end of every retro_run() */
+   if (compact)
+   {
+      lynx_rewind_push();
+      frames_since_context_save = 0;
+   }
 
-   return ret;
+   return lynx_state_save(data, size, compact);
 }
 
 bool retro_unserialize(const void *data, size_t size)
 {
    StateMem st;
    memset(&st, 0, sizeof(st));
-   st.data = (uint8_t*)data;
-   st.len  = size;
+   st.data    = (uint8_t*)data;
+   st.len     = size;
+   st.layouts = &state_layouts;
 
    return MDFNSS_LoadSM(&st, 0, 0);
 }
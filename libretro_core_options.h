@@ -82,6 +82,21 @@ struct retro_core_option_definition option_defs_us[] = {
       "16",
    },
 
+   {
+      "lynx_run_ahead",
+      "Run-Ahead Frames",
+      "Show the picture this many frames ahead of the emulated machine to remove input lag that games add themselves. The frames in between are run without video or sound. Setting this higher than the game's own lag makes the picture jump back when the input changes.",
+      {
+         { "disabled", NULL },
+         { "1", NULL },
+         { "2", NULL },
+         { "3", NULL },
+         { "4", NULL },
+         { NULL, NULL},
+      },
+      "disabled",
+   },
+
    { NULL, NULL, NULL, {{0}}, NULL },
 };
 
@@ -0,0 +1,164 @@
+#ifndef LIBRETRO_LYNX_H__
+#define LIBRETRO_LYNX_H__
+
+/* Lynx specific extensions to the libretro API.
+ *
+ * These are not part of libretro.h and are only reachable when the core
+ * objects are linked directly (benchmarks, headless tools); the shared
+ * library built with link.T exports nothing but retro_*. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <libretro.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Lynx master clock cycles (16 MHz) emulated by the last retro_run(). */
+uint32_t lynx_get_frame_cycles(void);
+
+struct lynx_perf_stats
+{
+   const char *ident;
+   uint64_t ticks;   /* host ticks spent in this counter alone */
+   uint64_t calls;
+};
+
+/* Per-frame aggregates of the built-in performance counters, covering the
+ * last retro_run() and any savestate calls made before it.  "lynx_frame"
+ * holds whatever the other counters don't cover, so the sum of all ticks
+ * is the frame's host time.  Ticks are CPU
+ * timestamp counter units where available, otherwise the frontend's perf
+ * counter or nanoseconds.  Fills at most 'max' entries and returns the
+ * number of counters, which is 0 unless built with NEED_PERF_COUNTERS=1. */
+unsigned lynx_perf_get_frame_stats(struct lynx_perf_stats *stats, unsigned max);
+
+/* Snapshot slots for rollback.  A slot is sized for the loaded game when
+ * it is created and holds one compact state, so saving and loading copy
+ * the machine without allocating or looking fields up by name.  Slots
+ * must be destroyed before the game is unloaded.
+ *
+ * Frames run again after a rollback should be run with the frontend
+ * reporting video and audio disabled through
+ * RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE: retro_run() then skips
+ * drawing lines and mixing sound and makes no video or audio callback,
+ * while the machine itself runs exactly as it would otherwise. */
+typedef struct lynx_snapshot lynx_snapshot_t;
+
+lynx_snapshot_t *lynx_snapshot_create(void);
+void lynx_snapshot_destroy(lynx_snapshot_t *snapshot);
+bool lynx_snapshot_save(lynx_snapshot_t *snapshot);
+bool lynx_snapshot_load(const lynx_snapshot_t *snapshot);
+
+/* Raw video.  Once enabled, retro_run() makes no video callback and doesn't
+ * produce pixels at all.  The frame is left as the display DMA read it from
+ * RAM instead: per line, 80 bytes of pens and the palette they are shown in.
+ * That is 8160 bytes of pens per frame, and palettes usually change between
+ * frames rather than within one. */
+
+#define LYNX_RAW_WIDTH  160
+#define LYNX_RAW_HEIGHT 102
+
+struct lynx_raw_line
+{
+   /* LYNX_RAW_WIDTH / 2 bytes of two pens each, NULL if the line wasn't
+    * drawn.  The left pen of a byte is in the high nibble, unless 'flip'
+    * is set: the line is then shown upside down, from the last byte to the
+    * first and with the low nibble first. */
+   const uint8_t *pens;
+   /* The 16 colours of the pens, 4 bits each of green (bits 0-3), red
+    * (4-7) and blue (8-11) */
+   const uint16_t *palette;
+   bool flip;
+};
+
+void lynx_set_raw_video(bool enable);
+
+/* Fills 'lines' with the last frame run with video enabled and returns the
+ * number of lines drawn.  The pointers stay valid until the next
+ * retro_run(). */
+unsigned lynx_get_raw_frame(struct lynx_raw_line lines[LYNX_RAW_HEIGHT]);
+
+/* Dirty page tracking of the 64K of system RAM, in pages of 256 bytes.
+ * Sets pages[n] to non-zero for every page written to since the last
+ * lynx_clear_dirty_pages() and returns the number of such pages.  Loading
+ * a state or resetting marks every page, the frames run ahead with the
+ * lynx_run_ahead option and undone again don't.  Writes from outside the
+ * emulated machine (cheats, the retro_get_memory_data() pointer) are not
+ * tracked.  Unless built with NEED_DIRTY_PAGES=1 every page is reported
+ * as dirty. */
+unsigned lynx_get_dirty_pages(uint8_t pages[256]);
+
+void lynx_clear_dirty_pages(void);
+
+/* Rewind.  Once enabled, the state at the end of every retro_run() is
+ * recorded as the difference to the frame before, in a ring of 'bytes'
+ * bytes that drops the oldest frames when it fills up.  The newest state
+ * and some work buffers are kept on top of that, about 2.5 times
+ * retro_serialize_size().  0 disables rewind and frees the memory;
+ * changing the budget drops the recorded frames.  While the frontend runs
+ * ahead or rolls back, reported through its savestate context, the frames
+ * recorded are those it saves a state of instead, as the others are
+ * thrown away again.  Returns false if the ring could not be allocated. */
+bool lynx_rewind_set_budget(size_t bytes);
+
+/* Number of frames lynx_rewind_step_back() can go back. */
+unsigned lynx_rewind_available(void);
+
+/* Restores the state of the frame before the last recorded one, returns
+ * false if there is none left. */
+bool lynx_rewind_step_back(void);
+
+/* Batches of independent machines running the same game, stepped in
+ * parallel on a pool of threads.  Only available when built with
+ * NEED_BATCH=1.  The machines share one copy of the BIOS and the cart ROM
+ * and do not use the retro_* state, so a batch can live next to a game
+ * loaded through retro_load_game(). */
+
+#define LYNX_BATCH_WIDTH  160
+#define LYNX_BATCH_HEIGHT 102
+
+typedef struct lynx_batch lynx_batch_t;
+
+/* Powers up 'count' machines running 'rom' (.lnx, headerless or BS93
+ * homebrew, as for retro_load_game()) with the boot ROM at 'bios_path'.
+ * The ROM data is only read during this call.  'threads' is the number of
+ * threads stepping the batch including the caller, 0 picks one per CPU.
+ * Returns NULL on failure. */
+lynx_batch_t *lynx_batch_create(unsigned count, const void *rom, size_t size,
+      const char *bios_path, unsigned threads);
+
+/* As lynx_batch_create(), but maps the ROM file at 'rom_path' rather than
+ * reading it into memory first. */
+lynx_batch_t *lynx_batch_create_file(unsigned count, const char *rom_path,
+      const char *bios_path, unsigned threads);
+
+void lynx_batch_destroy(lynx_batch_t *batch);
+
+unsigned lynx_batch_count(const lynx_batch_t *batch);
+
+/* Sets the buttons of machine 'index' for the following frames, with the
+ * bit layout the libretro input uses unrotated: A, B, Option 2, Option 1,
+ * Left, Right, Up, Down from bit 0 up and Pause in bit 8. */
+void lynx_batch_set_input(lynx_batch_t *batch, unsigned index, uint16_t buttons);
+
+/* Runs every machine for 'frames' frames and returns once all are done. */
+void lynx_batch_step(lynx_batch_t *batch, unsigned frames);
+
+/* Last frame of machine 'index', LYNX_BATCH_WIDTH x LYNX_BATCH_HEIGHT
+ * XRGB8888 pixels with no padding between lines. */
+const uint32_t *lynx_batch_get_video(const lynx_batch_t *batch, unsigned index);
+
+/* Interleaved stereo samples (44.1kHz) of the last frame of machine
+ * 'index', the number of sample pairs is stored in 'frames'. */
+const int16_t *lynx_batch_get_audio(const lynx_batch_t *batch, unsigned index, size_t *frames);
+
+/* The 64K of system RAM of machine 'index', writable between steps. */
+uint8_t *lynx_batch_get_ram(lynx_batch_t *batch, unsigned index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,418 @@
+/* Batches of Lynx machines stepped on a thread pool, see libretro_lynx.h.
+ *
+ * Machine 0 loads the game, the others are created from it and share its
+ * BIOS and cart ROM.  lynx_batch_step() hands the machines out to the pool
+ * one at a time through an atomic counter, so threads that finish their
+ * machines early pick up the remaining ones. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "mednafen/mednafen.h"
+#include "mednafen/git.h"
+#include "mednafen/lynx/system.h"
+#include "libretro_lynx.h"
+
+#define BATCH_SOUND_RATE  44100
+#define BATCH_SOUND_SIZE  4096   /* sample pairs, one frame is ~590 */
+
+#ifdef _WIN32
+typedef HANDLE             batch_thread_t;
+typedef CRITICAL_SECTION   batch_mutex_t;
+typedef CONDITION_VARIABLE batch_cond_t;
+#else
+typedef pthread_t          batch_thread_t;
+typedef pthread_mutex_t    batch_mutex_t;
+typedef pthread_cond_t     batch_cond_t;
+#endif
+
+struct lynx_machine
+{
+   CSystem *system;
+   MDFN_Surface surface;
+   uint32_t *pixels;
+   int16_t *sound;
+   size_t sound_frames;
+   uint16_t buttons;
+   bool started;
+};
+
+struct lynx_batch
+{
+   lynx_machine *machines;
+   unsigned count;
+
+   batch_thread_t *threads;
+   unsigned thread_count;     /* workers, not counting the caller */
+
+   batch_mutex_t lock;
+   batch_cond_t start;
+   batch_cond_t done;
+   unsigned generation;       /* bumped for every step */
+   unsigned busy;             /* workers still running the current step */
+   bool quit;
+
+   unsigned frames;
+   volatile long next;        /* next machine to claim */
+};
+
+static void batch_lock(lynx_batch *batch)
+{
+#ifdef _WIN32
+   EnterCriticalSection(&batch->lock);
+#else
+   pthread_mutex_lock(&batch->lock);
+#endif
+}
+
+static void batch_unlock(lynx_batch *batch)
+{
+#ifdef _WIN32
+   LeaveCriticalSection(&batch->lock);
+#else
+   pthread_mutex_unlock(&batch->lock);
+#endif
+}
+
+static void batch_wait(lynx_batch *batch, batch_cond_t *cond)
+{
+#ifdef _WIN32
+   SleepConditionVariableCS(cond, &batch->lock, INFINITE);
+#else
+   pthread_cond_wait(cond, &batch->lock);
+#endif
+}
+
+static void batch_wake_all(batch_cond_t *cond)
+{
+#ifdef _WIN32
+   WakeAllConditionVariable(cond);
+#else
+   pthread_cond_broadcast(cond);
+#endif
+}
+
+static unsigned batch_claim(lynx_batch *batch)
+{
+#ifdef _WIN32
+   return (unsigned)InterlockedIncrement(&batch->next) - 1;
+#else
+   return (unsigned)__sync_fetch_and_add(&batch->next, 1);
+#endif
+}
+
+static unsigned cpu_count(void)
+{
+#ifdef _WIN32
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return info.dwNumberOfProcessors;
+#else
+   long n = sysconf(_SC_NPROCESSORS_ONLN);
+   return n > 0 ? (unsigned)n : 1;
+#endif
+}
+
+static void machine_run(lynx_machine *m, unsigned frames)
+{
+   for (unsigned i = 0; i < frames; i++)
+   {
+      EmulateSpecStruct spec;
+      memset(&spec, 0, sizeof(spec));
+
+      spec.surface            = &m->surface;
+      spec.SoundRate          = BATCH_SOUND_RATE;
+      spec.SoundBuf           = m->sound;
+      spec.SoundBufMaxSize    = BATCH_SOUND_SIZE * 2;
+      spec.SoundVolume        = 1.0;
+      spec.soundmultiplier    = 1.0;
+      spec.VideoFormatChanged = !m->started;
+      spec.SoundFormatChanged = !m->started;
+      m->started = true;
+
+      m->system->SetButtonData(m->buttons);
+      m->system->Emulate(&spec);
+
+      m->sound_frames = spec.SoundBufSize;
+   }
+}
+
+static void batch_run_machines(lynx_batch *batch)
+{
+   for (;;)
+   {
+      unsigned index = batch_claim(batch);
+
+      if (index >= batch->count)
+         break;
+
+      machine_run(&batch->machines[index], batch->frames);
+   }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI batch_worker(void *data)
+#else
+static void *batch_worker(void *data)
+#endif
+{
+   lynx_batch *batch = (lynx_batch*)data;
+   unsigned seen = 0;
+
+   for (;;)
+   {
+      batch_lock(batch);
+      while (!batch->quit && batch->generation == seen)
+         batch_wait(batch, &batch->start);
+      seen = batch->generation;
+      if (batch->quit)
+      {
+         batch_unlock(batch);
+         break;
+      }
+      batch_unlock(batch);
+
+      batch_run_machines(batch);
+
+      batch_lock(batch);
+      if (--batch->busy == 0)
+         batch_wake_all(&batch->done);
+      batch_unlock(batch);
+   }
+
+   return 0;
+}
+
+static void batch_init_sync(lynx_batch *batch)
+{
+#ifdef _WIN32
+   InitializeCriticalSection(&batch->lock);
+   InitializeConditionVariable(&batch->start);
+   InitializeConditionVariable(&batch->done);
+#else
+   pthread_mutex_init(&batch->lock, NULL);
+   pthread_cond_init(&batch->start, NULL);
+   pthread_cond_init(&batch->done, NULL);
+#endif
+}
+
+static bool batch_start_threads(lynx_batch *batch, unsigned count)
+{
+   if (!count)
+      return true;
+
+   batch->threads = (batch_thread_t*)calloc(count, sizeof(*batch->threads));
+   if (!batch->threads)
+      return false;
+
+   for (; batch->thread_count < count; batch->thread_count++)
+   {
+#ifdef _WIN32
+      batch->threads[batch->thread_count] = CreateThread(NULL, 0, batch_worker, batch, 0, NULL);
+      if (!batch->threads[batch->thread_count])
+         return false;
+#else
+      if (pthread_create(&batch->threads[batch->thread_count], NULL, batch_worker, batch))
+         return false;
+#endif
+   }
+
+   return true;
+}
+
+static void batch_stop_threads(lynx_batch *batch)
+{
+   batch_lock(batch);
+   batch->quit = true;
+   batch_wake_all(&batch->start);
+   batch_unlock(batch);
+
+   for (unsigned i = 0; i < batch->thread_count; i++)
+   {
+#ifdef _WIN32
+      WaitForSingleObject(batch->threads[i], INFINITE);
+      CloseHandle(batch->threads[i]);
+#else
+      pthread_join(batch->threads[i], NULL);
+#endif
+   }
+
+   free(batch->threads);
+
+#ifdef _WIN32
+   DeleteCriticalSection(&batch->lock);
+#else
+   pthread_cond_destroy(&batch->done);
+   pthread_cond_destroy(&batch->start);
+   pthread_mutex_destroy(&batch->lock);
+#endif
+}
+
+static lynx_batch *batch_create(unsigned count, MDFNFILE *fp,
+      const char *bios_path, unsigned threads)
+{
+   lynx_batch *batch;
+
+   batch = (lynx_batch*)calloc(1, sizeof(*batch));
+   if (!batch)
+      return NULL;
+
+   batch->machines = (lynx_machine*)calloc(count, sizeof(*batch->machines));
+   if (!batch->machines)
+   {
+      free(batch);
+      return NULL;
+   }
+
+   batch_init_sync(batch);
+
+   for (batch->count = 0; batch->count < count; batch->count++)
+   {
+      lynx_machine *m = &batch->machines[batch->count];
+
+      m->pixels = (uint32_t*)calloc(LYNX_BATCH_WIDTH * LYNX_BATCH_HEIGHT, sizeof(uint32_t));
+      m->sound  = (int16_t*)calloc(BATCH_SOUND_SIZE * 2, sizeof(int16_t));
+      if (!m->pixels || !m->sound)
+      {
+         free(m->pixels);
+         free(m->sound);
+         break;
+      }
+
+      m->surface.pixels = (uint16*)m->pixels;
+      m->surface.width  = LYNX_BATCH_WIDTH;
+      m->surface.height = LYNX_BATCH_HEIGHT;
+      m->surface.pitch  = LYNX_BATCH_WIDTH;
+      m->surface.bpp    = 32;
+
+      if (batch->count == 0)
+         m->system = new CSystem(fp, bios_path);
+      else
+         m->system = new CSystem(*batch->machines[0].system, SHARE_IMAGE);
+   }
+
+   if (threads == 0)
+      threads = cpu_count();
+   if (threads > count)
+      threads = count;
+
+   if (batch->count < count || !batch_start_threads(batch, threads - 1))
+   {
+      lynx_batch_destroy(batch);
+      return NULL;
+   }
+
+   return batch;
+}
+
+lynx_batch_t *lynx_batch_create(unsigned count, const void *rom, size_t size,
+      const char *bios_path, unsigned threads)
+{
+   lynx_batch *batch;
+   MDFNFILE *fp;
+
+   if (!count || !rom || !size || !bios_path)
+      return NULL;
+
+   fp = file_open_mem((const uint8_t*)rom, size);
+   if (!fp)
+      return NULL;
+
+   batch = batch_create(count, fp, bios_path, threads);
+
+   /* The data belongs to the caller, only release the MDFNFILE itself */
+   fp->data = NULL;
+   file_close(fp);
+
+   return batch;
+}
+
+lynx_batch_t *lynx_batch_create_file(unsigned count, const char *rom_path,
+      const char *bios_path, unsigned threads)
+{
+   lynx_batch *batch;
+   MDFNFILE *fp;
+
+   if (!count || !rom_path || !bios_path)
+      return NULL;
+
+   fp = file_open_mmap(rom_path);
+   if (!fp)
+      return NULL;
+
+   batch = batch_create(count, fp, bios_path, threads);
+   file_close(fp);
+
+   return batch;
+}
+
+void lynx_batch_destroy(lynx_batch_t *batch)
+{
+   if (!batch)
+      return;
+
+   batch_stop_threads(batch);
+
+   for (unsigned i = 0; i < batch->count; i++)
+   {
+      lynx_machine *m = &batch->machines[i];
+
+      delete m->system;
+      free(m->pixels);
+      free(m->sound);
+   }
+
+   free(batch->machines);
+   free(batch);
+}
+
+unsigned lynx_batch_count(const lynx_batch_t *batch)
+{
+   return batch->count;
+}
+
+void lynx_batch_set_input(lynx_batch_t *batch, unsigned index, uint16_t buttons)
+{
+   batch->machines[index].buttons = buttons;
+}
+
+void lynx_batch_step(lynx_batch_t *batch, unsigned frames)
+{
+   batch_lock(batch);
+   batch->frames = frames;
+   batch->next   = 0;
+   batch->busy   = batch->thread_count;
+   batch->generation++;
+   batch_wake_all(&batch->start);
+   batch_unlock(batch);
+
+   batch_run_machines(batch);
+
+   batch_lock(batch);
+   while (batch->busy)
+      batch_wait(batch, &batch->done);
+   batch_unlock(batch);
+}
+
+const uint32_t *lynx_batch_get_video(const lynx_batch_t *batch, unsigned index)
+{
+   return batch->machines[index].pixels;
+}
+
+const int16_t *lynx_batch_get_audio(const lynx_batch_t *batch, unsigned index, size_t *frames)
+{
+   *frames = batch->machines[index].sound_frames;
+   return batch->machines[index].sound;
+}
+
+uint8_t *lynx_batch_get_ram(lynx_batch_t *batch, unsigned index)
+{
+   return batch->machines[index].system->GetRamPointer();
+}
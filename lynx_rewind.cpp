@@ -0,0 +1,232 @@
+/* Rewind buffer, see libretro_lynx.h.
+ *
+ * Only the state of the newest frame is kept whole.  Every frame adds a
+ * delta to a ring of 'budget' bytes: the XOR of the new state with the
+ * previous one, with the runs of zeros (bytes that did not change) taken
+ * out.  Stepping back XORs the newest delta into the current state, which
+ * gives the state of the frame before.  When the ring is full the oldest
+ * deltas are dropped. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+
+#include <libretro.h>
+#include "libretro_lynx.h"
+#include "lynx_rewind.h"
+
+struct rewind_entry
+{
+   size_t offset;
+   size_t size;
+};
+
+static uint8_t *ring;
+static size_t ring_size;
+static std::deque<rewind_entry> entries;
+
+static uint8_t *state;        /* state of the newest frame */
+static uint8_t *next_state;
+static uint8_t *scratch;      /* delta being encoded */
+static size_t state_size;
+static bool have_state;
+
+static void rewind_free_states(void)
+{
+   free(state);
+   free(next_state);
+   free(scratch);
+   state      = NULL;
+   next_state = NULL;
+   scratch    = NULL;
+   state_size = 0;
+   have_state = false;
+}
+
+static uint8_t *put_length(uint8_t *out, size_t len)
+{
+   while (len >= 0x80)
+   {
+      *out++ = (uint8_t)(len | 0x80);
+      len  >>= 7;
+   }
+   *out++ = (uint8_t)len;
+   return out;
+}
+
+static const uint8_t *get_length(const uint8_t *in, size_t *len)
+{
+   unsigned shift = 0;
+
+   *len = 0;
+   do
+   {
+      *len  |= (size_t)(*in & 0x7f) << shift;
+      shift += 7;
+   } while (*in++ & 0x80);
+
+   return in;
+}
+
+/* Encodes 'a' XOR 'b' as (unchanged length, changed length, changed bytes)
+ * triples.  The output is at most size * 3 / 2 + 16 bytes. */
+static size_t delta_encode(const uint8_t *a, const uint8_t *b, size_t size, uint8_t *out)
+{
+   uint8_t *start = out;
+   size_t pos     = 0;
+
+   while (pos < size)
+   {
+      size_t same = pos;
+      size_t diff;
+
+      while (same + 8 <= size)
+      {
+         uint64_t wa, wb;
+         memcpy(&wa, a + same, 8);
+         memcpy(&wb, b + same, 8);
+         if (wa != wb)
+            break;
+         same += 8;
+      }
+      while (same < size && a[same] == b[same])
+         same++;
+
+      diff = same;
+      while (diff < size && a[diff] != b[diff])
+         diff++;
+
+      out = put_length(out, same - pos);
+      out = put_length(out, diff - same);
+      for (size_t i = same; i < diff; i++)
+         *out++ = a[i] ^ b[i];
+
+      pos = diff;
+   }
+
+   return out - start;
+}
+
+static void delta_apply(uint8_t *dst, const uint8_t *delta, size_t delta_size)
+{
+   const uint8_t *end = delta + delta_size;
+
+   while (delta < end)
+   {
+      size_t same, diff;
+
+      delta = get_length(delta, &same);
+      delta = get_length(delta, &diff);
+      dst  += same;
+
+      for (size_t i = 0; i < diff; i++)
+         *dst++ ^= *delta++;
+   }
+}
+
+/* Finds room for 'size' bytes after the newest entry, dropping the oldest
+ * entries that are in the way. */
+static uint8_t *ring_alloc(size_t size)
+{
+   size_t offset = 0;
+
+   if (!entries.empty())
+      offset = entries.back().offset + entries.back().size;
+   if (offset + size > ring_size)
+      offset = 0;
+
+   while (!entries.empty() && entries.front().offset < offset + size &&
+         offset < entries.front().offset + entries.front().size)
+      entries.pop_front();
+
+   rewind_entry entry = { offset, size };
+   entries.push_back(entry);
+
+   return ring + offset;
+}
+
+bool lynx_rewind_set_budget(size_t bytes)
+{
+   free(ring);
+   ring      = NULL;
+   ring_size = 0;
+   entries.clear();
+   rewind_free_states();
+
+   if (!bytes)
+      return true;
+
+   ring = (uint8_t*)malloc(bytes);
+   if (!ring)
+      return false;
+
+   ring_size = bytes;
+   return true;
+}
+
+unsigned lynx_rewind_available(void)
+{
+   return entries.size();
+}
+
+bool lynx_rewind_step_back(void)
+{
+   if (entries.empty() || !have_state)
+      return false;
+
+   delta_apply(state, ring + entries.back().offset, entries.back().size);
+   entries.pop_back();
+
+   return retro_unserialize(state, state_size);
+}
+
+void lynx_rewind_reset(void)
+{
+   entries.clear();
+   rewind_free_states();
+}
+
+void lynx_rewind_push(void)
+{
+   size_t size;
+
+   if (!ring)
+      return;
+
+   size = lynx_state_size(true);
+   if (!size)
+      return;
+
+   if (size != state_size)
+   {
+      lynx_rewind_reset();
+
+      state      = (uint8_t*)malloc(size);
+      next_state = (uint8_t*)malloc(size);
+      scratch    = (uint8_t*)malloc(size * 3 / 2 + 16);
+      if (!state || !next_state || !scratch)
+      {
+         rewind_free_states();
+         return;
+      }
+      state_size = size;
+   }
+
+   if (!lynx_state_save(next_state, size, true))
+      return;
+
+   if (have_state)
+   {
+      size_t delta_size = delta_encode(next_state, state, size, scratch);
+
+      if (delta_size > ring_size)
+         entries.clear();
+      else
+         memcpy(ring_alloc(delta_size), scratch, delta_size);
+   }
+
+   uint8_t *tmp = state;
+   state        = next_state;
+   next_state   = tmp;
+   have_state   = true;
+}
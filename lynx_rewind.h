@@ -0,0 +1,20 @@
+#ifndef LYNX_REWIND_H__
+#define LYNX_REWIND_H__
+
+#include <stddef.h>
+
+/* Hooks for libretro.cpp, the public side is in libretro_lynx.h */
+
+/* Records the state at the end of a frame, does nothing unless enabled
+ * with lynx_rewind_set_budget(). */
+void lynx_rewind_push(void);
+
+/* Forgets the recorded frames, e.g. when the game is unloaded. */
+void lynx_rewind_reset(void);
+
+/* From libretro.cpp: the size of a state and saving one, named or compact.
+ * Compact states are smaller and faster but only this build reads them. */
+size_t lynx_state_size(bool compact);
+bool lynx_state_save(void *data, size_t size, bool compact);
+
+#endif
@@ -23,6 +23,13 @@
 
 #include <streams/file_stream.h>
 
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "file.h"
 
 struct MDFNFILE *file_open_mem(const uint8_t *data, int64_t size)
@@ -33,7 +40,10 @@ struct MDFNFILE *file_open_mem(const uint8_t *data, int64_t size)
       return NULL;
    
    if (!data || !size)
+   {
+      free(file);
       return NULL;
+   }
 
    file->data     = (uint8_t*)data;
    file->size     = size;
@@ -67,6 +77,51 @@ error:
    return NULL;
 }
 
+struct MDFNFILE *file_open_mmap(const char *path)
+{
+#ifdef HAVE_MMAP
+   struct stat st;
+   void *data;
+   const char *ld;
+   struct MDFNFILE *file;
+   int fd = open(path, O_RDONLY);
+
+   /* Anything that can't be mapped is read in as usual, which also covers
+    * paths only the frontend's VFS knows about */
+   if (fd < 0)
+      return file_open(path);
+
+   if (fstat(fd, &st) || st.st_size <= 0)
+   {
+      close(fd);
+      return file_open(path);
+   }
+
+   data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if (data == MAP_FAILED)
+      return file_open(path);
+
+   file = (struct MDFNFILE*)calloc(1, sizeof(*file));
+   if (!file)
+   {
+      munmap(data, st.st_size);
+      return file_open(path);
+   }
+
+   ld           = (const char*)strrchr(path, '.');
+   file->data   = (uint8_t*)data;
+   file->size   = st.st_size;
+   file->ext    = strdup(ld ? ld + 1 : "");
+   file->mapped = 1;
+
+   return file;
+#else
+   return file_open(path);
+#endif
+}
+
 int file_close(struct MDFNFILE *file)
 {
    if (!file)
@@ -77,7 +132,14 @@ int file_close(struct MDFNFILE *file)
    file->ext = NULL;
 
    if (file->data)
-      free(file->data);
+   {
+#ifdef HAVE_MMAP
+      if (file->mapped)
+         munmap(file->data, file->size);
+      else
+#endif
+         free(file->data);
+   }
    file->data = NULL;
 
    free(file);
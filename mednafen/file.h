@@ -13,11 +13,20 @@ struct MDFNFILE
    int64_t size;
    char *ext;
    int64_t location;
+   int mapped;       /* data is a read-only file mapping, only ever set by
+                        file_open_mmap() with HAVE_MMAP, 0 otherwise */
 };
 
 struct MDFNFILE *file_open_mem(const uint8_t *data, int64_t size);
 struct MDFNFILE *file_open(const char *path);
 
+/* Like file_open(), but maps the file instead of reading it in where the
+ * platform allows it.  The file is opened directly, not through the
+ * frontend's VFS, and is read in with file_open() whenever it can't be
+ * mapped.  Only worth it for large files such as carts.  The data must not
+ * be written to. */
+struct MDFNFILE *file_open_mmap(const char *path);
+
 int file_close(struct MDFNFILE *file);
 
 uint64_t file_read(struct MDFNFILE *file, void *ptr,
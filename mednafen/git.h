@@ -206,6 +206,16 @@ typedef struct
 	// Skip rendering this frame if true.  Set by the driver code.
 	int skip;
 
+	// Keep the frame in the emulated system's own format and don't render it
+	// to the surface.  Set by the driver code.
+	bool raw_video;
+
+	// Set by the driver code if it can show the last frame again.  A frame that
+	// looks exactly like the one before is then not rendered to the surface,
+	// and VideoUnchanged is set to TRUE by the emulation code.
+	bool CanDupe;
+	bool VideoUnchanged;
+
 	//
 	// If sound is disabled, the driver code must set SoundRate to false, SoundBuf to NULL, SoundBufMaxSize to 0.
 
@@ -45,32 +45,41 @@
 //
 // Addressing mode decoding
 //
+// Zero page addresses are masked to 8 bits even where the byte read can't
+// be larger, so the compiler can drop the I/O check from the accesses that
+// follow.  Indirect pointers are always fetched from zero page RAM.
+//
 
 #define	xIMMEDIATE()			{mOperand=mPC;mPC++;}
 #define	xABSOLUTE()				{mOperand=CPU_PEEKW(mPC);mPC+=2;}
-#define xZEROPAGE()				{mOperand=CPU_PEEK(mPC);mPC++;}
+#define xZEROPAGE()				{mOperand=CPU_PEEK(mPC)&0xff;mPC++;}
 #define xZEROPAGE_X()			{mOperand=CPU_PEEK(mPC)+mX;mPC++;mOperand&=0xff;}
 #define xZEROPAGE_Y()			{mOperand=CPU_PEEK(mPC)+mY;mPC++;mOperand&=0xff;}
 #define xABSOLUTE_X()			{mOperand=CPU_PEEKW(mPC);mPC+=2;mOperand+=mX;mOperand&=0xffff;}
 #define	xABSOLUTE_Y()			{mOperand=CPU_PEEKW(mPC);mPC+=2;mOperand+=mY;mOperand&=0xffff;}
 #define xINDIRECT_ABSOLUTE_X()	{mOperand=CPU_PEEKW(mPC);mPC+=2;mOperand+=mX;mOperand&=0xffff;mOperand=CPU_PEEKW(mOperand);}
 #define xRELATIVE()				{mOperand=CPU_PEEK(mPC);mPC++;mOperand=(mPC+mOperand)&0xffff;}
-#define xINDIRECT_X()			{mOperand=CPU_PEEK(mPC);mPC++;mOperand=mOperand+mX;mOperand&=0x00ff;mOperand=CPU_PEEKW(mOperand);}
-#define xINDIRECT_Y()			{mOperand=CPU_PEEK(mPC);mPC++;mOperand=CPU_PEEKW(mOperand);mOperand=mOperand+mY;mOperand&=0xffff;}
+#define xINDIRECT_X()			{mOperand=CPU_PEEK(mPC);mPC++;mOperand=mOperand+mX;mOperand&=0x00ff;mOperand=CPU_PEEKW_RAM(mOperand);}
+#define xINDIRECT_Y()			{mOperand=CPU_PEEK(mPC)&0xff;mPC++;mOperand=CPU_PEEKW_RAM(mOperand);mOperand=mOperand+mY;mOperand&=0xffff;}
 #define xINDIRECT_ABSOLUTE()	{mOperand=CPU_PEEKW(mPC);mPC+=2;mOperand=CPU_PEEKW(mOperand);}
-#define xINDIRECT()				{mOperand=CPU_PEEK(mPC);mPC++;mOperand=CPU_PEEKW(mOperand);}
+#define xINDIRECT()				{mOperand=CPU_PEEK(mPC)&0xff;mPC++;mOperand=CPU_PEEKW_RAM(mOperand);}
 
 //
 // Helper Macros
 //
-//#define SET_Z(m)				{ mZ=(m)?false:true; }
-//#define SET_N(m)				{ mN=(m&0x80)?true:false; }
-//#define SET_NZ(m)				SET_Z(m) SET_N(m)
-#define SET_Z(m)				{ mZ=!(m); }
-#define SET_N(m)				{ mN=(m)&0x80; }
-#define SET_NZ(m)				{ mZ=!(m); mN=(m)&0x80; }
-#define PULL(m)					{ mSP++; mSP&=0xff; m=CPU_PEEK(mSP+0x0100); }
-#define PUSH(m)					{ CPU_POKE(0x0100+mSP,m); mSP--; mSP&=0xff; }
+// N and Z are not kept as flags but worked out when they are read from
+// mNZ, which mostly just holds the last 8 bit result: Z is set when its low
+// byte is zero and N when bit 7 or 15 is.  Bit 15 lets BIT, TSB and TRB set
+// N independently of Z.
+//
+#define FLAG_N()				(mNZ&0x8080)
+#define FLAG_Z()				(!(mNZ&0xff))
+#define SET_Z(m)				{ mNZ=(FLAG_N()?0x8000:0)|((m)?1:0); }
+#define SET_NZ(m)				{ mNZ=(m); }
+#define PULL(m)					{ mSP++; mSP&=0xff; m=CPU_PEEK_RAM(mSP+0x0100); }
+#define PUSH(m)					{ CPU_POKE_RAM(0x0100+mSP,m); mSP--; mSP&=0xff; }
+#define GET_PS()				(0x20|(FLAG_N()?0x80:0)|(mV?0x40:0)|(mB?0x10:0)|(mD?0x08:0)|(mI?0x04:0)|(FLAG_Z()?0x02:0)|(mC?0x01:0))
+#define SET_PS(ps)				{ mNZ=(((ps)&0x80)<<8)|(((ps)&0x02)?0:1); mV=(ps)&0x40; mB=(ps)&0x10; mD=(ps)&0x08; mI=(ps)&0x04; mC=(ps)&0x01; }
 //
 // Opcode execution 
 //
@@ -80,30 +89,18 @@
 	int value=CPU_PEEK(mOperand);\
 	if(mD)\
 	{\
-		int c = mC?1:0;\
-		int lo = (mA & 0x0f) + (value & 0x0f) + c;\
-		int hi = (mA & 0xf0) + (value & 0xf0);\
-		mV=0;\
-		mC=0;\
-		if (lo > 0x09)\
-	    {\
-		    hi += 0x10;\
-			lo += 0x06;\
-	    }\
-		if (~(mA^value) & (mA^hi) & 0x80) mV=1;\
-	    if (hi > 0x90) hi += 0x60;\
-		if (hi & 0xff00) mC=1;\
-		mA = (lo & 0x0f) + (hi & 0xf0);\
+		int lo = DecimalAdd[mC!=0][mA & 0x0f][value & 0x0f];\
+		int hi = DecimalAdd[lo >> 4 & 1][mA >> 4][value >> 4];\
+		mV = ~(mA^value) & (mA^(hi << 2)) & 0x80;\
+		mC = hi >> 4 & 1;\
+		mA = ((hi & 0x0f) << 4) | (lo & 0x0f);\
 	}\
 	else\
 	{\
-		int c = mC?1:0;\
-		int sum = mA + value + c;\
-	    mV=0;\
-		mC=0;\
-	    if (~(mA^value) & (mA^sum) & 0x80) mV=1;\
-		if (sum & 0xff00) mC=1;\
-	    mA = (uint8) sum;\
+		int sum = mA + value + (mC!=0);\
+		mV = ~(mA^value) & (mA^sum) & 0x80;\
+		mC = sum >> 8;\
+		mA = sum & 0xff;\
 	}\
 	SET_NZ(mA)\
 }
@@ -166,7 +163,7 @@
 
 #define	xBEQ()\
 {\
-	if(mZ)\
+	if(FLAG_Z())\
 	{\
 		int offset=(signed char)CPU_PEEK(mPC);\
 		mPC++;\
@@ -187,17 +184,20 @@
 #define	xBIT()\
 {\
 	int value=CPU_PEEK(mOperand);\
-	SET_Z(mA&value);\
 \
 	if(mOpcode!=0x89)\
 	{\
-		mN=value&0x80;\
+		mNZ=((value&0x80)<<8)|((mA&value)?1:0);\
 		mV=value&0x40;\
 	}\
+	else\
+	{\
+		SET_Z(mA&value);\
+	}\
 }
 #define	xBMI()\
 {\
-	if(mN)\
+	if(FLAG_N())\
 	{\
 		int offset=(signed char)CPU_PEEK(mPC);\
 		mPC++;\
@@ -213,7 +213,7 @@
 
 #define	xBNE()\
 {\
-	if(!mZ)\
+	if(!FLAG_Z())\
 	{\
 		int offset=(signed char)CPU_PEEK(mPC);\
 		mPC++;\
@@ -229,7 +229,7 @@
 
 #define	xBPL()\
 {\
-	if(!mN)\
+	if(!FLAG_N())\
 	{\
 		int offset=(signed char)CPU_PEEK(mPC);\
 		mPC++;\
@@ -256,7 +256,7 @@
 	mPC++;\
     PUSH(mPC>>8);\
 	PUSH(mPC&0xff);\
-	PUSH(PS()|0x10);\
+	PUSH(GET_PS()|0x10);\
 \
 	mD=false;\
 	mI=true;\
@@ -468,7 +468,7 @@
 
 #define	xPHP()\
 {\
-	PUSH(PS());\
+	PUSH(GET_PS());\
 }
 
 #define	xPHX()\
@@ -491,7 +491,7 @@
 {\
 	int P;\
 	PULL(P);\
-	PS(P);\
+	SET_PS(P);\
 }
 
 #define	xPLX()\
@@ -550,7 +550,7 @@
 {\
 	int tmp;\
 	PULL(tmp);\
-	PS(tmp);\
+	SET_PS(tmp);\
 	PULL(mPC);\
 	PULL(tmp);\
 	mPC|=tmp<<8;\
@@ -570,28 +570,18 @@
 	int value=CPU_PEEK(mOperand);\
 	if (mD)\
 	{\
-		int c = mC?0:1;\
-		int sum = mA - value - c;\
-		int lo = (mA & 0x0f) - (value & 0x0f) - c;\
-		int hi = (mA & 0xf0) - (value & 0xf0);\
-	    mV=0;\
-		mC=0;\
-	    if ((mA^value) & (mA^sum) & 0x80) mV=1;\
-	    if (lo & 0xf0) lo -= 6;\
-	    if (lo & 0x80) hi -= 0x10;\
-	    if (hi & 0x0f00) hi -= 0x60;\
-	    if ((sum & 0xff00) == 0) mC=1;\
-	    mA = (lo & 0x0f) + (hi & 0xf0);\
+		int lo = DecimalSub[mC==0][mA & 0x0f][value & 0x0f];\
+		int hi = DecimalSub[lo >> 4 & 1][mA >> 4][value >> 4];\
+		mV = (mA^value) & (mA^(hi << 2)) & 0x80;\
+		mC = !(hi & 0x10);\
+		mA = ((hi & 0x0f) << 4) | (lo & 0x0f);\
 	}\
 	else\
 	{\
-		int c = mC?0:1;\
-		int sum = mA - value - c;\
-	    mV=0;\
-		mC=0;\
-	    if ((mA^value) & (mA^sum) & 0x80) mV=1;\
-	    if ((sum & 0xff00) == 0) mC=1;\
-	    mA = (uint8) sum;\
+		int sum = mA - value - (mC==0);\
+		mV = (mA^value) & (mA^sum) & 0x80;\
+		mC = (sum >= 0);\
+		mA = sum & 0xff;\
 	}\
 	SET_NZ(mA)\
 }
@@ -618,7 +608,7 @@
 
 #define	xSTP()\
 {\
-	gSystemCPUSleep=true;\
+	mState.SystemCPUSleep=true;\
 }
 
 #define	xSTX()\
@@ -689,6 +679,6 @@
 
 #define	xWAI()\
 {\
-	gSystemCPUSleep=true;\
+	mState.SystemCPUSleep=true;\
 }
 
@@ -2,15 +2,207 @@
 
 #include "c65c02.h"
 
-void C65C02::Update(void)
+//
+// Opcode dispatch.  With GCC style computed goto the opcode bodies below are
+// direct-threaded: every body ends by checking the batch limits and jumping
+// straight to the next opcode through the table, giving each opcode its own
+// indirect branch for the host predictor.  Otherwise, or with
+// NO_COMPUTED_GOTO, the same bodies form a plain switch.
+//
+#if defined(__GNUC__) && !defined(NO_COMPUTED_GOTO)
+#define CPU_THREADED_DISPATCH
+#endif
+
+//
+// Decimal mode ADC and SBC work a digit at a time through these tables,
+// indexed by the carry (borrow for SBC) into the digit and the two digits.
+// Bits 0-3 are the digit of the result, bit 4 the carry or borrow out and
+// bit 5 is bit 3 of the digit before the decimal adjust, which is what the
+// V flag is taken from.  Invalid digits give the same results as the
+// arithmetic they replace.
+//
+static const uint8 DecimalAdd[2][16][16]=
+{
+	{
+		{0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35},
+		{0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16},
+		{0x02,0x03,0x04,0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17},
+		{0x03,0x04,0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18},
+		{0x04,0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19},
+		{0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a},
+		{0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b},
+		{0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c},
+		{0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d},
+		{0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e},
+		{0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f},
+		{0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30},
+		{0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30,0x31},
+		{0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30,0x31,0x32},
+		{0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30,0x31,0x32,0x33},
+		{0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30,0x31,0x32,0x33,0x34}
+	},
+	{
+		{0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16},
+		{0x02,0x03,0x04,0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17},
+		{0x03,0x04,0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18},
+		{0x04,0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19},
+		{0x05,0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a},
+		{0x06,0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b},
+		{0x07,0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c},
+		{0x28,0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d},
+		{0x29,0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e},
+		{0x30,0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f},
+		{0x31,0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30},
+		{0x32,0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30,0x31},
+		{0x33,0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30,0x31,0x32},
+		{0x34,0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30,0x31,0x32,0x33},
+		{0x35,0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30,0x31,0x32,0x33,0x34},
+		{0x16,0x17,0x18,0x19,0x1a,0x1b,0x1c,0x1d,0x3e,0x3f,0x30,0x31,0x32,0x33,0x34,0x35}
+	}
+};
+
+static const uint8 DecimalSub[2][16][16]=
+{
+	{
+		{0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f,0x1e,0x1d,0x1c,0x1b},
+		{0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f,0x1e,0x1d,0x1c},
+		{0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f,0x1e,0x1d},
+		{0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f,0x1e},
+		{0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f},
+		{0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10},
+		{0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11},
+		{0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32},
+		{0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33},
+		{0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34},
+		{0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35},
+		{0x2b,0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36},
+		{0x2c,0x2b,0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37},
+		{0x2d,0x2c,0x2b,0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38},
+		{0x2e,0x2d,0x2c,0x2b,0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39},
+		{0x2f,0x2e,0x2d,0x2c,0x2b,0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00}
+	},
+	{
+		{0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f,0x1e,0x1d,0x1c,0x1b,0x1a},
+		{0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f,0x1e,0x1d,0x1c,0x1b},
+		{0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f,0x1e,0x1d,0x1c},
+		{0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f,0x1e,0x1d},
+		{0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f,0x1e},
+		{0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10,0x1f},
+		{0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11,0x10},
+		{0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32,0x11},
+		{0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33,0x32},
+		{0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34,0x33},
+		{0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35,0x34},
+		{0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36,0x35},
+		{0x2b,0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37,0x36},
+		{0x2c,0x2b,0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38,0x37},
+		{0x2d,0x2c,0x2b,0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39,0x38},
+		{0x2e,0x2d,0x2c,0x2b,0x2a,0x29,0x28,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00,0x39}
+	}
+};
+
+#define ADDCYC(x)	{ cycles += ((x) * 4); if(suzie_done) suzie_done += ((x) * 4); }
+
+//
+// Run() keeps the registers in locals that shadow the members of the same
+// name, so the opcode macros work on them unchanged, and the cycle counter
+// and Suzie done time in 'cycles' and 'suzie_done'.  Mikie and Suzie read and
+// change the cycle state, so mState is brought up to date around every
+// access that leaves RAM and the batch limit is recomputed afterwards.
+//
+#define RUN_SYNC_OUT()	(mState.SystemCycleCount=cycles, mState.SuzieDoneTime=suzie_done)
+#define RUN_SYNC_IN()	(cycles=mState.SystemCycleCount, suzie_done=mState.SuzieDoneTime, run_limit=(mState.NextTimerEvent<mRunUntil)?mState.NextTimerEvent:mRunUntil)
+
+// The CPU always belongs to a CSystem, its access handlers are called
+// directly rather than through CSystemBase
+#define CPU_SYSTEM		(static_cast<CSystem&>(mSystem))
+
+#undef CPU_PEEK
+#undef CPU_PEEKW
+#undef CPU_POKE
+#define CPU_PEEK(m)				(((m<0xfc00)?mRamPointer[m]:(RUN_SYNC_OUT(),io_data=CPU_SYSTEM.CSystem::Peek_CPU(m),RUN_SYNC_IN(),io_data)))
+#define CPU_PEEKW(m)			(((m<0xfc00)?(mRamPointer[m]+(mRamPointer[m+1]<<8)):(RUN_SYNC_OUT(),io_data=CPU_SYSTEM.CSystem::PeekW_CPU(m),RUN_SYNC_IN(),io_data)))
+#define CPU_POKE(m1,m2)			{if(m1<0xfc00) { mRamPointer[m1]=m2; RAM_MARK_DIRTY(mDirtyPages,m1); } else { RUN_SYNC_OUT(); CPU_SYSTEM.CSystem::Poke_CPU(m1,m2); RUN_SYNC_IN(); }}
+
+// Keep running while the CPU is awake and no timer event or limit is due
+#define RUN_CONTINUE	(!mState.SystemCPUSleep && cycles<run_limit)
+
+#define IRQ_PENDING		(mState.SystemIRQ && !mI && !mIRQActive)
+
+#ifdef CPU_THREADED_DISPATCH
+#define OPCODE(n)		op_##n:
+#define OPCODE_END		{ if(!RUN_CONTINUE) break; if(IRQ_PENDING) continue; mOpcode=CPU_PEEK(mPC); mPC++; goto *dispatch[mOpcode]; }
+#else
+#define OPCODE(n)		case n:
+#define OPCODE_END		break
+#endif
+
+//
+// Execute instructions until the CPU sleeps, the next timer event is due or
+// the cycle count reaches 'until'.  At least one instruction is executed
+// if the CPU is awake, Break() ends the batch after the current one.  The
+// members and mState are only up to date again once Run() returns.
+//
+void C65C02::Run(uint32 until)
 {
-		if(gSystemCPUSleep) return;
-		if(gSystemIRQ && !mI && !mIRQActive)
+#ifdef CPU_THREADED_DISPATCH
+	static const void* const dispatch[256]=
+	{
+		&&op_0x00, &&op_0x01, &&op_0xEA, &&op_0xEA, &&op_0x04, &&op_0x05, &&op_0x06, &&op_0xEA, &&op_0x08, &&op_0x09, &&op_0x0A, &&op_0xEA, &&op_0x0C, &&op_0x0D, &&op_0x0E, &&op_0xEA,
+		&&op_0x10, &&op_0x11, &&op_0x12, &&op_0xEA, &&op_0x14, &&op_0x15, &&op_0x16, &&op_0xEA, &&op_0x18, &&op_0x19, &&op_0x1A, &&op_0xEA, &&op_0x1C, &&op_0x1D, &&op_0x1E, &&op_0xEA,
+		&&op_0x20, &&op_0x21, &&op_0xEA, &&op_0xEA, &&op_0x24, &&op_0x25, &&op_0x26, &&op_0xEA, &&op_0x28, &&op_0x29, &&op_0x2A, &&op_0xEA, &&op_0x2C, &&op_0x2D, &&op_0x2E, &&op_0xEA,
+		&&op_0x30, &&op_0x31, &&op_0x32, &&op_0xEA, &&op_0x34, &&op_0x35, &&op_0x36, &&op_0xEA, &&op_0x38, &&op_0x39, &&op_0x3A, &&op_0xEA, &&op_0x3C, &&op_0x3D, &&op_0x3E, &&op_0xEA,
+		&&op_0x40, &&op_0x41, &&op_0xEA, &&op_0xEA, &&op_0xEA, &&op_0x45, &&op_0x46, &&op_0xEA, &&op_0x48, &&op_0x49, &&op_0x4A, &&op_0xEA, &&op_0x4C, &&op_0x4D, &&op_0x4E, &&op_0xEA,
+		&&op_0x50, &&op_0x51, &&op_0x52, &&op_0xEA, &&op_0xEA, &&op_0x55, &&op_0x56, &&op_0xEA, &&op_0x58, &&op_0x59, &&op_0x5A, &&op_0xEA, &&op_0xEA, &&op_0x5D, &&op_0x5E, &&op_0xEA,
+		&&op_0x60, &&op_0x61, &&op_0xEA, &&op_0xEA, &&op_0x64, &&op_0x65, &&op_0x66, &&op_0xEA, &&op_0x68, &&op_0x69, &&op_0x6A, &&op_0xEA, &&op_0x6C, &&op_0x6D, &&op_0x6E, &&op_0xEA,
+		&&op_0x70, &&op_0x71, &&op_0x72, &&op_0xEA, &&op_0x74, &&op_0x75, &&op_0x76, &&op_0xEA, &&op_0x78, &&op_0x79, &&op_0x7A, &&op_0xEA, &&op_0x7C, &&op_0x7D, &&op_0x7E, &&op_0xEA,
+		&&op_0x80, &&op_0x81, &&op_0xEA, &&op_0xEA, &&op_0x84, &&op_0x85, &&op_0x86, &&op_0xEA, &&op_0x88, &&op_0x89, &&op_0x8A, &&op_0xEA, &&op_0x8C, &&op_0x8D, &&op_0x8E, &&op_0xEA,
+		&&op_0x90, &&op_0x91, &&op_0x92, &&op_0xEA, &&op_0x94, &&op_0x95, &&op_0x96, &&op_0xEA, &&op_0x98, &&op_0x99, &&op_0x9A, &&op_0xEA, &&op_0x9C, &&op_0x9D, &&op_0x9E, &&op_0xEA,
+		&&op_0xA0, &&op_0xA1, &&op_0xA2, &&op_0xEA, &&op_0xA4, &&op_0xA5, &&op_0xA6, &&op_0xEA, &&op_0xA8, &&op_0xA9, &&op_0xAA, &&op_0xEA, &&op_0xAC, &&op_0xAD, &&op_0xAE, &&op_0xEA,
+		&&op_0xB0, &&op_0xB1, &&op_0xB2, &&op_0xEA, &&op_0xB4, &&op_0xB5, &&op_0xB6, &&op_0xEA, &&op_0xB8, &&op_0xB9, &&op_0xBA, &&op_0xEA, &&op_0xBC, &&op_0xBD, &&op_0xBE, &&op_0xEA,
+		&&op_0xC0, &&op_0xC1, &&op_0xEA, &&op_0xEA, &&op_0xC4, &&op_0xC5, &&op_0xC6, &&op_0xEA, &&op_0xC8, &&op_0xC9, &&op_0xCA, &&op_0xCB, &&op_0xCC, &&op_0xCD, &&op_0xCE, &&op_0xEA,
+		&&op_0xD0, &&op_0xD1, &&op_0xD2, &&op_0xEA, &&op_0xEA, &&op_0xD5, &&op_0xD6, &&op_0xEA, &&op_0xD8, &&op_0xD9, &&op_0xDA, &&op_0xDB, &&op_0xEA, &&op_0xDD, &&op_0xDE, &&op_0xEA,
+		&&op_0xE0, &&op_0xE1, &&op_0xEA, &&op_0xEA, &&op_0xE4, &&op_0xE5, &&op_0xE6, &&op_0xEA, &&op_0xE8, &&op_0xE9, &&op_0xEA, &&op_0xEA, &&op_0xEC, &&op_0xED, &&op_0xEE, &&op_0xEA,
+		&&op_0xF0, &&op_0xF1, &&op_0xF2, &&op_0xEA, &&op_0xEA, &&op_0xF5, &&op_0xF6, &&op_0xEA, &&op_0xF8, &&op_0xF9, &&op_0xFA, &&op_0xEA, &&op_0xEA, &&op_0xFD, &&op_0xFE, &&op_0xEA
+	};
+#endif
+
+	if(mState.SystemCPUSleep) return;
+
+	mRunUntil=until;
+	mRegsChanged=false;
+
+	int mA=this->mA;
+	int mX=this->mX;
+	int mY=this->mY;
+	int mSP=this->mSP;
+	int mOpcode=this->mOpcode;
+	int mOperand=this->mOperand;
+	int mPC=this->mPC;
+	int mNZ=this->mNZ;
+	int mV=this->mV;
+	int mB=this->mB;
+	int mD=this->mD;
+	int mI=this->mI;
+	int mC=this->mC;
+	uint8 *mRamPointer=this->mRamPointer;
+#ifdef WANT_DIRTY_PAGES
+	uint8 *mDirtyPages=this->mDirtyPages;
+#endif
+	LynxState &mState=this->mState;
+	uint32 cycles=mState.SystemCycleCount;
+	uint32 suzie_done=mState.SuzieDoneTime;
+	uint32 run_limit=(mState.NextTimerEvent<mRunUntil)?mState.NextTimerEvent:mRunUntil;
+	int io_data;
+
+	do
+	{
+		if(IRQ_PENDING)
 		{
 			// Push processor status
 			PUSH(mPC>>8);
 			PUSH(mPC&0xff);
-			PUSH(PS()&0xef);		// Clear B flag on stack
+			PUSH(GET_PS()&0xef);	// Clear B flag on stack
 
 			mI=true;				// Stop further interrupts
 			mD=false;				// Clear decimal mode
@@ -18,972 +210,1002 @@ void C65C02::Update(void)
 			// Pick up the new PC
 			mPC=CPU_PEEKW(IRQ_VECTOR);
 		}
-	// Fetch opcode
-	mOpcode=CPU_PEEK(mPC);
-	mPC++;
 
-	// Execute Opcode
+		// Fetch opcode
+		mOpcode=CPU_PEEK(mPC);
+		mPC++;
 
-	switch(mOpcode)
-	{
-#define ADDCYC(x)	{ gSystemCycleCount += ((x) * 4); if(gSuzieDoneTime) gSuzieDoneTime += ((x) * 4); }
+		// Execute Opcode
+
+#ifdef CPU_THREADED_DISPATCH
+		goto *dispatch[mOpcode];
+#else
+		switch(mOpcode)
+		{
+#endif
 //
 // 0x00
 //
-		case 0x00:
+		OPCODE(0x00)
 			ADDCYC(7);
 			// IMPLIED
 			xBRK();
-			break;
-		case 0x01:
+			OPCODE_END;
+		OPCODE(0x01)
 			ADDCYC(6);
 			xINDIRECT_X();
 			xORA();
-			break;
-		case 0x04:
+			OPCODE_END;
+		OPCODE(0x04)
 			ADDCYC(5);
 			xZEROPAGE();
 			xTSB();
-			break;
-		case 0x05:
+			OPCODE_END;
+		OPCODE(0x05)
 			ADDCYC(3);
 			xZEROPAGE();
 			xORA();
-			break;
-		case 0x06:
+			OPCODE_END;
+		OPCODE(0x06)
 			ADDCYC(5);
 			xZEROPAGE();
 			xASL();
-			break;
-		case 0x08:
+			OPCODE_END;
+		OPCODE(0x08)
 			ADDCYC(3);
 			// IMPLIED
 			xPHP();
-			break;
-		case 0x09:
+			OPCODE_END;
+		OPCODE(0x09)
 			ADDCYC(3);
 			xIMMEDIATE();
 			xORA();
-			break;
-		case 0x0A:
+			OPCODE_END;
+		OPCODE(0x0A)
 			ADDCYC(2);
 			// IMPLIED
 			xASLA();
-			break;
-		case 0x0C:
+			OPCODE_END;
+		OPCODE(0x0C)
 			ADDCYC(6);
 			xABSOLUTE();
 			xTSB();
-			break;
-		case 0x0D:
+			OPCODE_END;
+		OPCODE(0x0D)
 			ADDCYC(4);
 			xABSOLUTE();
 			xORA();
-			break;
-		case 0x0E:
+			OPCODE_END;
+		OPCODE(0x0E)
 			ADDCYC(6);
-			gSystemCycleCount+=(1+(5*CPU_RDWR_CYC));
+			cycles+=(1+(5*CPU_RDWR_CYC));
 			xABSOLUTE();
 			xASL();
-			break;
+			OPCODE_END;
 
 //
 // 0x10
 //
-		case 0x10:
+		OPCODE(0x10)
 			ADDCYC(2);
 			// RELATIVE (IN FUNCTION)
 			xBPL();
-			break;
-		case 0x11:
+			OPCODE_END;
+		OPCODE(0x11)
 			ADDCYC(5);
 			xINDIRECT_Y();
 			xORA();
-			break;
-		case 0x12:
+			OPCODE_END;
+		OPCODE(0x12)
 			ADDCYC(5);
 			xINDIRECT();
 			xORA();
-			break;
-		case 0x14:
+			OPCODE_END;
+		OPCODE(0x14)
 			ADDCYC(5);
 			xZEROPAGE();
 			xTRB();
-			break;
-		case 0x15:
+			OPCODE_END;
+		OPCODE(0x15)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xORA();
-			break;
-		case 0x16:
+			OPCODE_END;
+		OPCODE(0x16)
 			ADDCYC(6);
 			xZEROPAGE_X();
 			xASL();
-			break;
-		case 0x18:
+			OPCODE_END;
+		OPCODE(0x18)
 			ADDCYC(2);
 			// IMPLIED
 			xCLC();
-			break;
-		case 0x19:
+			OPCODE_END;
+		OPCODE(0x19)
 			ADDCYC(4);
 			xABSOLUTE_Y();
 			xORA();
-			break;
-		case 0x1A:
+			OPCODE_END;
+		OPCODE(0x1A)
 			ADDCYC(2);
 			// IMPLIED
 			xINCA();
-			break;
-		case 0x1C:
+			OPCODE_END;
+		OPCODE(0x1C)
 			ADDCYC(6);
 			xABSOLUTE();
 			xTRB();
-			break;
-		case 0x1D:
+			OPCODE_END;
+		OPCODE(0x1D)
 			ADDCYC(4);
 			xABSOLUTE_X();
 			xORA();
-			break;
-		case 0x1E:
+			OPCODE_END;
+		OPCODE(0x1E)
 			ADDCYC(7);
 			xABSOLUTE_X();
 			xASL();
-			break;
+			OPCODE_END;
 
 //
 // 0x20
 //
-		case 0x20:
+		OPCODE(0x20)
 			ADDCYC(6);
 			xABSOLUTE();
 			xJSR();
-			break;
-		case 0x21:
+			OPCODE_END;
+		OPCODE(0x21)
 			ADDCYC(6);
 			xINDIRECT_X();
 			xAND();
-			break;
-		case 0x24:
+			OPCODE_END;
+		OPCODE(0x24)
 			ADDCYC(3);
 			xZEROPAGE();
 			xBIT();
-			break;
-		case 0x25:
+			OPCODE_END;
+		OPCODE(0x25)
 			ADDCYC(3);
 			xZEROPAGE();
 			xAND();
-			break;
-		case 0x26:
+			OPCODE_END;
+		OPCODE(0x26)
 			ADDCYC(5);
 			xZEROPAGE();
 			xROL();
-			break;
-		case 0x28:
+			OPCODE_END;
+		OPCODE(0x28)
 			ADDCYC(4);
 			// IMPLIED
 			xPLP();
-			break;
-		case 0x29:
+			OPCODE_END;
+		OPCODE(0x29)
 			ADDCYC(2);
 			xIMMEDIATE();
 			xAND();
-			break;
-		case 0x2A:
+			OPCODE_END;
+		OPCODE(0x2A)
 			ADDCYC(2);
 			// IMPLIED
 			xROLA();
-			break;
-		case 0x2C:
+			OPCODE_END;
+		OPCODE(0x2C)
 			ADDCYC(4);
 			xABSOLUTE();
 			xBIT();
-			break;
-		case 0x2D:
+			OPCODE_END;
+		OPCODE(0x2D)
 			ADDCYC(4);
 			xABSOLUTE();
 			xAND();
-			break;
-		case 0x2E:
+			OPCODE_END;
+		OPCODE(0x2E)
 			ADDCYC(6);
 			xABSOLUTE();
 			xROL();
-			break;
+			OPCODE_END;
 //
 // 0x30
 //
-		case 0x30:
+		OPCODE(0x30)
 			ADDCYC(2);
 			// RELATIVE (IN FUNCTION)
 			xBMI();
-			break;
-		case 0x31:
+			OPCODE_END;
+		OPCODE(0x31)
 			ADDCYC(5);
 			xINDIRECT_Y();
 			xAND();
-			break;
-		case 0x32:
+			OPCODE_END;
+		OPCODE(0x32)
 			ADDCYC(5);
 			xINDIRECT();
 			xAND();
-			break;
-		case 0x34:
+			OPCODE_END;
+		OPCODE(0x34)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xBIT();
-			break;
-		case 0x35:
+			OPCODE_END;
+		OPCODE(0x35)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xAND();
-			break;
-		case 0x36:
+			OPCODE_END;
+		OPCODE(0x36)
 			ADDCYC(6);
 			xZEROPAGE_X();
 			xROL();
-			break;
-		case 0x38:
+			OPCODE_END;
+		OPCODE(0x38)
 			ADDCYC(2);
 			// IMPLIED
 			xSEC();
-			break;
-		case 0x39:
+			OPCODE_END;
+		OPCODE(0x39)
 			ADDCYC(4);
 			xABSOLUTE_Y();
 			xAND();
-			break;
-		case 0x3A:
+			OPCODE_END;
+		OPCODE(0x3A)
 			ADDCYC(2);
 			// IMPLIED
 			xDECA();
-			break;
-		case 0x3C:
+			OPCODE_END;
+		OPCODE(0x3C)
 			ADDCYC(4);
 			xABSOLUTE_X();
 			xBIT();
-			break;
-		case 0x3D:
+			OPCODE_END;
+		OPCODE(0x3D)
 			ADDCYC(4);
 			xABSOLUTE_X();
 			xAND();
-			break;
-		case 0x3E:
+			OPCODE_END;
+		OPCODE(0x3E)
 			ADDCYC(7);
 			xABSOLUTE_X();
 			xROL();
-			break;
+			OPCODE_END;
 //
 // 0x40
 //
-		case 0x40:
+		OPCODE(0x40)
 			ADDCYC(6);
 			// IMPLIED
 			xRTI();
-			break;
-		case 0x41:
+			OPCODE_END;
+		OPCODE(0x41)
 			ADDCYC(6);
 			xINDIRECT_X();
 			xEOR();
-			break;
-		case 0x45:
+			OPCODE_END;
+		OPCODE(0x45)
 			ADDCYC(3);
 			xZEROPAGE();
 			xEOR();
-			break;
-		case 0x46:
+			OPCODE_END;
+		OPCODE(0x46)
 			ADDCYC(5);
 			xZEROPAGE();
 			xLSR();
-			break;
-		case 0x48:
+			OPCODE_END;
+		OPCODE(0x48)
 			ADDCYC(3);
 			// IMPLIED
 			xPHA();
-			break;
-		case 0x49:
+			OPCODE_END;
+		OPCODE(0x49)
 			ADDCYC(2);
 			xIMMEDIATE();
 			xEOR();
-			break;
-		case 0x4A:
+			OPCODE_END;
+		OPCODE(0x4A)
 			ADDCYC(2);
 			// IMPLIED
 			xLSRA();
-			break;
-		case 0x4C:
+			OPCODE_END;
+		OPCODE(0x4C)
 			ADDCYC(3);
 			xABSOLUTE();
 			xJMP();
-			break;
-		case 0x4D:
+			OPCODE_END;
+		OPCODE(0x4D)
 			ADDCYC(4);
 			xABSOLUTE();
 			xEOR();
-			break;
-		case 0x4E:
+			OPCODE_END;
+		OPCODE(0x4E)
 			ADDCYC(6);
 			xABSOLUTE();
 			xLSR();
-			break;
+			OPCODE_END;
 
 //
 // 0x50
 //
-		case 0x50:
+		OPCODE(0x50)
 			ADDCYC(2);
 			// RELATIVE (IN FUNCTION)
 			xBVC();
-			break;
-		case 0x51:
+			OPCODE_END;
+		OPCODE(0x51)
 			ADDCYC(5);
 			xINDIRECT_Y();
 			xEOR();
-			break;
-		case 0x52:
+			OPCODE_END;
+		OPCODE(0x52)
 			ADDCYC(5);
 			xINDIRECT();
 			xEOR();
-			break;
-		case 0x55:
+			OPCODE_END;
+		OPCODE(0x55)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xEOR();
-			break;
-		case 0x56:
+			OPCODE_END;
+		OPCODE(0x56)
 			ADDCYC(6);
 			xZEROPAGE_X();
 			xLSR();
-			break;
-		case 0x58:
+			OPCODE_END;
+		OPCODE(0x58)
 			ADDCYC(2);
 			// IMPLIED
 			xCLI();
-			break;
-		case 0x59:
+			OPCODE_END;
+		OPCODE(0x59)
 			ADDCYC(4);
 			xABSOLUTE_Y();
 			xEOR();
-			break;
-		case 0x5A:
+			OPCODE_END;
+		OPCODE(0x5A)
 			ADDCYC(3);
 			// IMPLIED
 			xPHY();
-			break;
-		case 0x5D:
+			OPCODE_END;
+		OPCODE(0x5D)
 			ADDCYC(4);
 			xABSOLUTE_X();
 			xEOR();
-			break;
-		case 0x5E:
+			OPCODE_END;
+		OPCODE(0x5E)
 			ADDCYC(7);
 			xABSOLUTE_X();
 			xLSR();
-			break;
+			OPCODE_END;
 
 //
 // 0x60
 //
-		case 0x60:
+		OPCODE(0x60)
 			ADDCYC(6);
 			// IMPLIED
 			xRTS();
-			break;
-		case 0x61:
+			OPCODE_END;
+		OPCODE(0x61)
 			ADDCYC(6);
 			xINDIRECT_X();
 			xADC();
-			break;
-		case 0x64:
+			OPCODE_END;
+		OPCODE(0x64)
 			ADDCYC(3);
 			xZEROPAGE();
 			xSTZ();
-			break;
-		case 0x65:
+			OPCODE_END;
+		OPCODE(0x65)
 			ADDCYC(3);
 			xZEROPAGE();
 			xADC();
-			break;
-		case 0x66:
+			OPCODE_END;
+		OPCODE(0x66)
 			ADDCYC(5);
 			xZEROPAGE();
 			xROR();
-			break;
-		case 0x68:
+			OPCODE_END;
+		OPCODE(0x68)
 			ADDCYC(4);
 			// IMPLIED
 			xPLA();
-			break;
-		case 0x69:
+			OPCODE_END;
+		OPCODE(0x69)
 			ADDCYC(2);
 			xIMMEDIATE();
 			xADC();
-			break;
-		case 0x6A:
+			OPCODE_END;
+		OPCODE(0x6A)
 			ADDCYC(2);
 			// IMPLIED
 			xRORA();
-			break;
-		case 0x6C:
+			OPCODE_END;
+		OPCODE(0x6C)
 			ADDCYC(6);
 			xINDIRECT_ABSOLUTE();
 			xJMP();
-			break;
-		case 0x6D:
+			OPCODE_END;
+		OPCODE(0x6D)
 			ADDCYC(4);
 			xABSOLUTE();
 			xADC();
-			break;
-		case 0x6E:
+			OPCODE_END;
+		OPCODE(0x6E)
 			ADDCYC(6);
 			xABSOLUTE();
 			xROR();
-			break;
+			OPCODE_END;
 //
 // 0x70
 //
-		case 0x70:
+		OPCODE(0x70)
 			ADDCYC(2);
 			// RELATIVE (IN FUNCTION)
 			xBVS();
-			break;
-		case 0x71:
+			OPCODE_END;
+		OPCODE(0x71)
 			ADDCYC(5);
 			xINDIRECT_Y();
 			xADC();
-			break;
-		case 0x72:
+			OPCODE_END;
+		OPCODE(0x72)
 			ADDCYC(5);
 			xINDIRECT();
 			xADC();
-			break;
-		case 0x74:
+			OPCODE_END;
+		OPCODE(0x74)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xSTZ();
-			break;
-		case 0x75:
+			OPCODE_END;
+		OPCODE(0x75)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xADC();
-			break;
-		case 0x76:
+			OPCODE_END;
+		OPCODE(0x76)
 			ADDCYC(6);
 			xZEROPAGE_X();
 			xROR();
-			break;
-		case 0x78:
+			OPCODE_END;
+		OPCODE(0x78)
 			ADDCYC(2);
 			// IMPLIED
 			xSEI();
-			break;
-		case 0x79:
-			gSystemCycleCount+=(1+(3*CPU_RDWR_CYC));
+			OPCODE_END;
+		OPCODE(0x79)
+			cycles+=(1+(3*CPU_RDWR_CYC));
 			xABSOLUTE_Y();
 			xADC();
-			break;
-		case 0x7A:
+			OPCODE_END;
+		OPCODE(0x7A)
 			ADDCYC(4);
 			// IMPLIED
 			xPLY();
-			break;
-		case 0x7C:
+			OPCODE_END;
+		OPCODE(0x7C)
 			ADDCYC(6);
 			xINDIRECT_ABSOLUTE_X();
 			xJMP();
-			break;
-		case 0x7D:
+			OPCODE_END;
+		OPCODE(0x7D)
 			ADDCYC(4);
 			xABSOLUTE_X();
 			xADC();
-			break;
-		case 0x7E:
+			OPCODE_END;
+		OPCODE(0x7E)
 			ADDCYC(7);
 			xABSOLUTE_X();
 			xROR();
-			break;
+			OPCODE_END;
 //
 // 0x80
 //
-		case 0x80:
+		OPCODE(0x80)
 			ADDCYC(3);
 			// RELATIVE (IN FUNCTION)
 			xBRA();
-			break;
-		case 0x81:
+			OPCODE_END;
+		OPCODE(0x81)
 			ADDCYC(6);
 			xINDIRECT_X();
 			xSTA();
-			break;
-		case 0x84:
+			OPCODE_END;
+		OPCODE(0x84)
 			ADDCYC(3);
 			xZEROPAGE();
 			xSTY();
-			break;
-		case 0x85:
+			OPCODE_END;
+		OPCODE(0x85)
 			ADDCYC(3);
 			xZEROPAGE();
 			xSTA();
-			break;
-		case 0x86:
+			OPCODE_END;
+		OPCODE(0x86)
 			ADDCYC(3);
 			xZEROPAGE();
 			xSTX();
-			break;
-		case 0x88:
+			OPCODE_END;
+		OPCODE(0x88)
 			ADDCYC(2);
 			// IMPLIED
 			xDEY();
-			break;
-		case 0x89:
+			OPCODE_END;
+		OPCODE(0x89)
 			ADDCYC(3);
 			xIMMEDIATE();
 			xBIT();
-			break;
-		case 0x8A:
+			OPCODE_END;
+		OPCODE(0x8A)
 			ADDCYC(2);
 			// IMPLIED
 			xTXA();
-			break;
-		case 0x8C:
+			OPCODE_END;
+		OPCODE(0x8C)
 			ADDCYC(4);
 			xABSOLUTE();
 			xSTY();
-			break;
-		case 0x8D:
+			OPCODE_END;
+		OPCODE(0x8D)
 			ADDCYC(4);
 			xABSOLUTE();
 			xSTA();
-			break;
-		case 0x8E:
+			OPCODE_END;
+		OPCODE(0x8E)
 			ADDCYC(4);
 			xABSOLUTE();
 			xSTX();
-			break;
+			OPCODE_END;
 
 //
 // 0x90
 //
-		case 0x90:
+		OPCODE(0x90)
 			ADDCYC(2);
 			// RELATIVE (IN FUNCTION)
 			xBCC();
-			break;
-		case 0x91:
+			OPCODE_END;
+		OPCODE(0x91)
 			ADDCYC(6);
 			xINDIRECT_Y();
 			xSTA();
-			break;
-		case 0x92:
+			OPCODE_END;
+		OPCODE(0x92)
 			ADDCYC(5);
 			xINDIRECT();
 			xSTA();
-			break;
-		case 0x94:
+			OPCODE_END;
+		OPCODE(0x94)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xSTY();
-			break;
-		case 0x95:
+			OPCODE_END;
+		OPCODE(0x95)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xSTA();
-			break;
-		case 0x96:
+			OPCODE_END;
+		OPCODE(0x96)
 			ADDCYC(4);
 			xZEROPAGE_Y();
 			xSTX();
-			break;
-		case 0x98:
+			OPCODE_END;
+		OPCODE(0x98)
 			ADDCYC(2);
 			// IMPLIED
 			xTYA();
-			break;
-		case 0x99:
+			OPCODE_END;
+		OPCODE(0x99)
 			ADDCYC(5);
 			xABSOLUTE_Y();
 			xSTA();
-			break;
-		case 0x9A:
+			OPCODE_END;
+		OPCODE(0x9A)
 			ADDCYC(2);
 			// IMPLIED
 			xTXS();
-			break;
-		case 0x9C:
+			OPCODE_END;
+		OPCODE(0x9C)
 			ADDCYC(4);
 			xABSOLUTE();
 			xSTZ();
-			break;
-		case 0x9D:
+			OPCODE_END;
+		OPCODE(0x9D)
 			ADDCYC(5);
 			xABSOLUTE_X();
 			xSTA();
-			break;
-		case 0x9E:
+			OPCODE_END;
+		OPCODE(0x9E)
 			ADDCYC(5);
 			xABSOLUTE_X();
 			xSTZ();
-			break;
+			OPCODE_END;
 
 //
 // 0xA0
 //
-		case 0xA0:
+		OPCODE(0xA0)
 			ADDCYC(2);
 			xIMMEDIATE();
 			xLDY();
-			break;
-		case 0xA1:
+			OPCODE_END;
+		OPCODE(0xA1)
 			ADDCYC(6);
 			xINDIRECT_X();
 			xLDA();
-			break;
-		case 0xA2:
+			OPCODE_END;
+		OPCODE(0xA2)
 			ADDCYC(2);
 			xIMMEDIATE();
 			xLDX();
-			break;
-		case 0xA4:
+			OPCODE_END;
+		OPCODE(0xA4)
 			ADDCYC(3);
 			xZEROPAGE();
 			xLDY();
-			break;
-		case 0xA5:
+			OPCODE_END;
+		OPCODE(0xA5)
 			ADDCYC(3);
 			xZEROPAGE();
 			xLDA();
-			break;
-		case 0xA6:
+			OPCODE_END;
+		OPCODE(0xA6)
 			ADDCYC(3);
 			xZEROPAGE();
 			xLDX();
-			break;
-		case 0xA8:
+			OPCODE_END;
+		OPCODE(0xA8)
 			ADDCYC(2);
 			// IMPLIED
 			xTAY();
-			break;
-		case 0xA9:
+			OPCODE_END;
+		OPCODE(0xA9)
 			ADDCYC(2);
 			xIMMEDIATE();
 			xLDA();
-			break;
-		case 0xAA:
+			OPCODE_END;
+		OPCODE(0xAA)
 			ADDCYC(2);
 			// IMPLIED
 			xTAX();
-			break;
-		case 0xAC:
+			OPCODE_END;
+		OPCODE(0xAC)
 			ADDCYC(4);
 			xABSOLUTE();
 			xLDY();
-			break;
-		case 0xAD:
+			OPCODE_END;
+		OPCODE(0xAD)
 			ADDCYC(4);
 			xABSOLUTE();
 			xLDA();
-			break;
-		case 0xAE:
+			OPCODE_END;
+		OPCODE(0xAE)
 			ADDCYC(4);
 			xABSOLUTE();
 			xLDX();
-			break;
+			OPCODE_END;
 
 //
 // 0xB0
 //
-		case 0xB0:
+		OPCODE(0xB0)
 			ADDCYC(2);
 			// RELATIVE (IN FUNCTION)
 			xBCS();
-			break;
-		case 0xB1:
+			OPCODE_END;
+		OPCODE(0xB1)
 			ADDCYC(5);
 			xINDIRECT_Y();
 			xLDA();
-			break;
-		case 0xB2:
+			OPCODE_END;
+		OPCODE(0xB2)
 			ADDCYC(5);
 			xINDIRECT();
 			xLDA();
-			break;
-		case 0xB4:
+			OPCODE_END;
+		OPCODE(0xB4)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xLDY();
-			break;
-		case 0xB5:
+			OPCODE_END;
+		OPCODE(0xB5)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xLDA();
-			break;
-		case 0xB6:
+			OPCODE_END;
+		OPCODE(0xB6)
 			ADDCYC(4);
 			xZEROPAGE_Y();
 			xLDX();
-			break;
-		case 0xB8:
+			OPCODE_END;
+		OPCODE(0xB8)
 			ADDCYC(2);
 			// IMPLIED
 			xCLV();
-			break;
-		case 0xB9:
+			OPCODE_END;
+		OPCODE(0xB9)
 			ADDCYC(4);
 			xABSOLUTE_Y();
 			xLDA();
-			break;
-		case 0xBA:
+			OPCODE_END;
+		OPCODE(0xBA)
 			ADDCYC(2);
 			// IMPLIED
 			xTSX();
-			break;
-		case 0xBC:
+			OPCODE_END;
+		OPCODE(0xBC)
 			ADDCYC(4);
 			xABSOLUTE_X();
 			xLDY();
-			break;
-		case 0xBD:
+			OPCODE_END;
+		OPCODE(0xBD)
 			ADDCYC(4);
 			xABSOLUTE_X();
 			xLDA();
-			break;
-		case 0xBE:
+			OPCODE_END;
+		OPCODE(0xBE)
 			ADDCYC(4);
 			xABSOLUTE_Y();
 			xLDX();
-			break;
+			OPCODE_END;
 
 //
 // 0xC0
 //
-		case 0xC0:
+		OPCODE(0xC0)
 			ADDCYC(2);
 			xIMMEDIATE();
 			xCPY();
-			break;
-		case 0xC1:
+			OPCODE_END;
+		OPCODE(0xC1)
 			ADDCYC(6);
 			xINDIRECT_X();
 			xCMP();
-			break;
-		case 0xC4:
+			OPCODE_END;
+		OPCODE(0xC4)
 			ADDCYC(3);
 			xZEROPAGE();
 			xCPY();
-			break;
-		case 0xC5:
+			OPCODE_END;
+		OPCODE(0xC5)
 			ADDCYC(3);
 			xZEROPAGE();
 			xCMP();
-			break;
-		case 0xC6:
+			OPCODE_END;
+		OPCODE(0xC6)
 			ADDCYC(5);
 			xZEROPAGE();
 			xDEC();
-			break;
-		case 0xC8:
+			OPCODE_END;
+		OPCODE(0xC8)
 			ADDCYC(2);
 			// IMPLIED
 			xINY();
-			break;
-		case 0xC9:
+			OPCODE_END;
+		OPCODE(0xC9)
 			ADDCYC(2);
 			xIMMEDIATE();
 			xCMP();
-			break;
-		case 0xCA:
+			OPCODE_END;
+		OPCODE(0xCA)
 			ADDCYC(2);
 			// IMPLIED
 			xDEX();
-			break;
-		case 0xCB:
+			OPCODE_END;
+		OPCODE(0xCB)
 			ADDCYC(2);
 			// IMPLIED
 			xWAI();
-			break;
-		case 0xCC:
+			OPCODE_END;
+		OPCODE(0xCC)
 			ADDCYC(4);
 			xABSOLUTE();
 			xCPY();
-			break;
-		case 0xCD:
+			OPCODE_END;
+		OPCODE(0xCD)
 			ADDCYC(4);
 			xABSOLUTE();
 			xCMP();
-			break;
-		case 0xCE:
+			OPCODE_END;
+		OPCODE(0xCE)
 			ADDCYC(6);
 			xABSOLUTE();
 			xDEC();
-			break;
+			OPCODE_END;
 //
 // 0xD0
 //
-		case 0xD0:
+		OPCODE(0xD0)
 			ADDCYC(2);
 			// RELATIVE (IN FUNCTION)
 			xBNE();
-			break;
-		case 0xD1:
+			OPCODE_END;
+		OPCODE(0xD1)
 			ADDCYC(5);			
 			xINDIRECT_Y();
 			xCMP();
-			break;
-		case 0xD2:
+			OPCODE_END;
+		OPCODE(0xD2)
 			ADDCYC(5);
 			xINDIRECT();
 			xCMP();
-			break;
-		case 0xD5:
+			OPCODE_END;
+		OPCODE(0xD5)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xCMP();
-			break;
-		case 0xD6:
+			OPCODE_END;
+		OPCODE(0xD6)
 			ADDCYC(6);
 			xZEROPAGE_X();
 			xDEC();
-			break;
-		case 0xD8:
+			OPCODE_END;
+		OPCODE(0xD8)
 			ADDCYC(2);
 			// IMPLIED
 			xCLD();
-			break;
-		case 0xD9:
+			OPCODE_END;
+		OPCODE(0xD9)
 			ADDCYC(4);
 			xABSOLUTE_Y();
 			xCMP();
-			break;
-		case 0xDA:
+			OPCODE_END;
+		OPCODE(0xDA)
 			ADDCYC(3);
 			// IMPLIED
 			xPHX();
-			break;
-		case 0xDB:
+			OPCODE_END;
+		OPCODE(0xDB)
 			ADDCYC(2);
 			// IMPLIED
 			xSTP();
-			break;
-		case 0xDD:
+			OPCODE_END;
+		OPCODE(0xDD)
 			ADDCYC(4);
 			xABSOLUTE_X();
 			xCMP();
-			break;
-		case 0xDE:
+			OPCODE_END;
+		OPCODE(0xDE)
 			ADDCYC(7);
 			xABSOLUTE_X();
 			xDEC();
-			break;
+			OPCODE_END;
 //
 // 0xE0
 //
-		case 0xE0:
+		OPCODE(0xE0)
 			ADDCYC(2);
 			xIMMEDIATE();
 			xCPX();
-			break;
-		case 0xE1:
+			OPCODE_END;
+		OPCODE(0xE1)
 			ADDCYC(6);
 			xINDIRECT_X();
 			xSBC();
-			break;
-		case 0xE4:
+			OPCODE_END;
+		OPCODE(0xE4)
 			ADDCYC(3);
 			xZEROPAGE();
 			xCPX();
-			break;
-		case 0xE5:
+			OPCODE_END;
+		OPCODE(0xE5)
 			ADDCYC(3);
 			xZEROPAGE();
 			xSBC();
-			break;
-		case 0xE6:
+			OPCODE_END;
+		OPCODE(0xE6)
 			ADDCYC(5);
 			xZEROPAGE();
 			xINC();
-			break;
-		case 0xE8:
+			OPCODE_END;
+		OPCODE(0xE8)
 			ADDCYC(2);
 			// IMPLIED
 			xINX();
-			break;
-		case 0xE9:
+			OPCODE_END;
+		OPCODE(0xE9)
 			ADDCYC(2);
 			xIMMEDIATE();
 			xSBC();
-			break;
+			OPCODE_END;
+#ifndef CPU_THREADED_DISPATCH
 		default:
-		case 0xEA:
+#endif
+		OPCODE(0xEA)
 			ADDCYC(2);
 			// IMPLIED
 			xNOP();
-			break;
-		case 0xEC:
+			OPCODE_END;
+		OPCODE(0xEC)
 			ADDCYC(4);
 			xABSOLUTE();
 			xCPX();
-			break;
-		case 0xED:
+			OPCODE_END;
+		OPCODE(0xED)
 			ADDCYC(4);
 			xABSOLUTE();
 			xSBC();
-			break;
-		case 0xEE:
+			OPCODE_END;
+		OPCODE(0xEE)
 			ADDCYC(6);
 			xABSOLUTE();
 			xINC();
-			break;
+			OPCODE_END;
 //
 // 0xF0
 //
-		case 0xF0:
+		OPCODE(0xF0)
 			ADDCYC(2);
 			// RELATIVE (IN FUNCTION)
 			xBEQ();
-			break;
-		case 0xF1:
+			OPCODE_END;
+		OPCODE(0xF1)
 			ADDCYC(5);
 			xINDIRECT_Y();
 			xSBC();
-			break;
-		case 0xF2:
+			OPCODE_END;
+		OPCODE(0xF2)
 			ADDCYC(5);
 			xINDIRECT();
 			xSBC();
-			break;
-		case 0xF5:
+			OPCODE_END;
+		OPCODE(0xF5)
 			ADDCYC(4);
 			xZEROPAGE_X();
 			xSBC();
-			break;
-		case 0xF6:
+			OPCODE_END;
+		OPCODE(0xF6)
 			ADDCYC(6);
 			xZEROPAGE_X();
 			xINC();
-			break;
-		case 0xF8:
+			OPCODE_END;
+		OPCODE(0xF8)
 			ADDCYC(2);
 			// IMPLIED
 			xSED();
-			break;
-		case 0xF9:
+			OPCODE_END;
+		OPCODE(0xF9)
 			ADDCYC(4);
 			xABSOLUTE_Y();
 			xSBC();
-			break;
-		case 0xFA:
+			OPCODE_END;
+		OPCODE(0xFA)
 			ADDCYC(4);
 			// IMPLIED
 			xPLX();
-			break;
-		case 0xFD:
+			OPCODE_END;
+		OPCODE(0xFD)
 			ADDCYC(4);
 			xABSOLUTE_X();
 			xSBC();
-			break;
-		case 0xFE:
+			OPCODE_END;
+		OPCODE(0xFE)
 			ADDCYC(7);
 			xABSOLUTE_X();
 			xINC();
-			break;
+			OPCODE_END;
+
+#ifndef CPU_THREADED_DISPATCH
+		}
+#endif
+	} while(RUN_CONTINUE);
+
+	RUN_SYNC_OUT();
+
+	// A reset inside the batch has already loaded the registers
+	if(!mRegsChanged)
+	{
+		this->mA=mA;
+		this->mX=mX;
+		this->mY=mY;
+		this->mSP=mSP;
+		this->mOpcode=mOpcode;
+		this->mOperand=mOperand;
+		this->mPC=mPC;
+		this->mNZ=mNZ;
+		this->mV=mV;
+		this->mB=mB;
+		this->mD=mD;
+		this->mI=mI;
+		this->mC=mC;
 	}
 }
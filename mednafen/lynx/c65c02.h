@@ -65,7 +65,12 @@
 
 #define CPU_PEEK(m)				(((m<0xfc00)?mRamPointer[m]:mSystem.Peek_CPU(m)))
 #define CPU_PEEKW(m)			(((m<0xfc00)?(mRamPointer[m]+(mRamPointer[m+1]<<8)):mSystem.PeekW_CPU(m)))
-#define CPU_POKE(m1,m2)			{if(m1<0xfc00) mRamPointer[m1]=m2; else mSystem.Poke_CPU(m1,m2);}
+#define CPU_POKE(m1,m2)			{if(m1<0xfc00) { mRamPointer[m1]=m2; RAM_MARK_DIRTY(mDirtyPages,m1); } else mSystem.Poke_CPU(m1,m2);}
+
+// Zero page and the stack page are always RAM
+#define CPU_PEEK_RAM(m)			(mRamPointer[m])
+#define CPU_PEEKW_RAM(m)		(mRamPointer[m]+(mRamPointer[(m)+1]<<8))
+#define CPU_POKE_RAM(m1,m2)		{ mRamPointer[m1]=m2; RAM_MARK_DIRTY(mDirtyPages,m1); }
 
 
 enum {	illegal=0,
@@ -113,15 +118,10 @@ typedef struct
 class C65C02
 {
 	public:
-		C65C02(CSystemBase& parent)
-			:mSystem(parent)
+		C65C02(CSystemBase& parent, LynxState& state)
+			:mSystem(parent),
+			mState(state)
 		{
-			// Compute the BCD lookup table
-			for(uint16 t=0;t<256;++t)
-			{
-				mBCDTable[0][t]=((t >> 4) * 10) + (t & 0x0f);
-				mBCDTable[1][t]=(((t % 100) / 10) << 4) | (t % 10);
-			}
 			Reset();
 			
 		}
@@ -134,6 +134,7 @@ class C65C02
 		inline void Reset(void)
 		{
 			mRamPointer=mSystem.GetRamPointer();
+			mDirtyPages=mSystem.GetDirtyPages();
 			mA=0;
 		    mX=0;
 		    mY=0;
@@ -141,18 +142,19 @@ class C65C02
 			mOpcode=0;
 			mOperand=0;
 			mPC=CPU_PEEKW(BOOT_VECTOR);
-			mN=false;
+			mNZ=0;
 			mV=false;
 			mB=false;
 			mD=false;
 			mI=true;
-			mZ=true;
 			mC=false;
 			mIRQActive=false;
+			mRunUntil=0;
+			mRegsChanged=true;
 
-			gSystemNMI=false;
-			gSystemIRQ=false;
-			gSystemCPUSleep=false;
+			mState.SystemNMI=false;
+			mState.SystemIRQ=false;
+			mState.SystemCPUSleep=false;
 		}
 
                 inline 	int StateAction(StateMem *sm, int load, int data_only)
@@ -178,7 +180,10 @@ class C65C02
                         return 1;
                 }
 
-	void Update(void);
+	void Run(uint32 until);
+
+		// End the current Run() batch after the instruction being executed
+		inline void Break(void) { mRunUntil=0; }
 
 //		inline void SetBreakpoint(uint32 breakpoint) {mPcBreakpoint=breakpoint;};
 
@@ -192,9 +197,10 @@ class C65C02
 			mOpcode=regs.Opcode;
 			mOperand=regs.Operand;
 			mPC=regs.PC;
-			gSystemCPUSleep=regs.WAIT;
-			gSystemNMI=regs.NMI;
-			gSystemIRQ=regs.IRQ;
+			mState.SystemCPUSleep=regs.WAIT;
+			mState.SystemNMI=regs.NMI;
+			mState.SystemIRQ=regs.IRQ;
+			mRegsChanged=true;
 		}
 
 		INLINE void GetRegs(C6502_REGS &regs)
@@ -207,15 +213,16 @@ class C65C02
 			regs.Opcode=mOpcode;
 			regs.Operand=mOperand;
 			regs.PC=mPC;
-			regs.WAIT=(gSystemCPUSleep)?true:false;
-			regs.NMI=(gSystemNMI)?true:false;
-			regs.IRQ=(gSystemIRQ)?true:false;
+			regs.WAIT=(mState.SystemCPUSleep)?true:false;
+			regs.NMI=(mState.SystemNMI)?true:false;
+			regs.IRQ=(mState.SystemIRQ)?true:false;
 		}
 
 		inline int GetPC(void) { return mPC; }
 
 	private:
 		CSystemBase	&mSystem;
+		LynxState	&mState;
 
 		// CPU Flags & status
 
@@ -227,21 +234,20 @@ class C65C02
 		int mOperand; // Intructions operand		  16 bits
 		int mPC;		// Program Counter            16 bits
 
-		int mN;		// N flag for processor status register
+		int mNZ;		// N & Z flags for processor status register, see c6502mak.h
 		int mV;		// V flag for processor status register
 		int mB;		// B flag for processor status register
 		int mD;		// D flag for processor status register
 		int mI;		// I flag for processor status register
-		int mZ;		// Z flag for processor status register
 		int mC;		// C flag for processor status register
 
 		int mIRQActive;
 
 		uint8 *mRamPointer;
+		uint8 *mDirtyPages;
 
-		// Associated lookup tables
-
-	    int mBCDTable[2][256];
+		uint32 mRunUntil;	// Cycle limit of the current Run() batch
+		bool mRegsChanged;	// Registers were set from outside a Run() batch
 
 	//
 	// Opcode prototypes
@@ -252,28 +258,14 @@ class C65C02
 		// Answers value of the Processor Status register
 		INLINE int PS(void) const
 		{
-			uint8 ps = 0x20;
-			if(mN) ps|=0x80;
-			if(mV) ps|=0x40;
-			if(mB) ps|=0x10;
-			if(mD) ps|=0x08;
-			if(mI) ps|=0x04;
-			if(mZ) ps|=0x02;
-			if(mC) ps|=0x01;
-			return ps;
+			return GET_PS();
 		}
 
 
 		// Change the processor flags to correspond to the given value
 		INLINE void PS(int ps)
 		{
-			mN=ps&0x80;
-			mV=ps&0x40;
-			mB=ps&0x10;
-			mD=ps&0x08;
-			mI=ps&0x04;
-			mZ=ps&0x02;
-			mC=ps&0x01;
+			SET_PS(ps);
 		}
 
 };
@@ -50,7 +50,6 @@
 #include <string.h>
 #include "cart.h"
 #include "../state.h"
-#include "../md5.h"
 #include "../../scrc32.h"
 #include "../mednafen-endian.h"
 
@@ -218,16 +217,13 @@ CCart::CCart(MDFNFILE *fp)
 	mWriteEnableBank0=false;
 	mWriteEnableBank1=false;
 	mCartRAM=false;
+	mCartRAMData=NULL;
 	mCRC32=0;
 
 	if(fp)
 	{
 		gamesize = fp->size;
 
-		// Calculate file's CRC32
-		mCRC32 = crc32(0, fp->data, gamesize);
-	   	MDFN_printf("File CRC32:   0x%08X.\n", mCRC32);
-
 		// Checkout the header bytes
 		file_read(fp, raw_header, sizeof(LYNX_HEADER), 1);
 		header = DecodeHeader(raw_header);
@@ -263,12 +259,12 @@ CCart::CCart(MDFNFILE *fp)
 	}
 
 	InfoROMSize = gamesize;
-	mCRC32 = 0;
 
     if (fp)
     {
-       // re-calculate file crc32 minus header if any
+       // A single pass over the ROM data, the header is not part of the CRC
        mCRC32     = crc32(0, fp->data + header_size, gamesize);
+       MDFN_printf("ROM CRC32:    0x%08X.\n", mCRC32);
        LYNX_DB db = CheckHash(mCRC32);
        if (found)
        {
@@ -366,10 +362,15 @@ CCart::CCart(MDFNFILE *fp)
 			break;
 	}
 
-    // Make some space for the new carts
+	mPageMask0=mMaskBank0?0xff:0;
+	mPageMask1=mMaskBank1?0xff:0;
+
+	// Make some space for the new carts
+
+	mImage = LynxImage::Create(mMaskBank0+1+mMaskBank1+1);
 
-	mCartBank0 = new uint8[mMaskBank0+1];
-	mCartBank1 = new uint8[mMaskBank1+1];
+	uint8 *data0 = mImage->data;
+	uint8 *data1 = mImage->data+mMaskBank0+1;
 
 	// Set default bank
 
@@ -378,21 +379,17 @@ CCart::CCart(MDFNFILE *fp)
 	// Initialiase
 
 	for(loop=0;loop<mMaskBank0+1;loop++)
-		mCartBank0[loop] = DEFAULT_CART_CONTENTS;
+		data0[loop] = DEFAULT_CART_CONTENTS;
 
 	for(loop=0;loop<mMaskBank1+1;loop++)
-		mCartBank1[loop] = DEFAULT_CART_CONTENTS;
+		data1[loop] = DEFAULT_CART_CONTENTS;
 
 	// Read in the BANK0 bytes
 
-	md5_context md5;
-	md5.starts();
-
 	if (mMaskBank0)
    {
 		uint64 size = std::min<uint64>(gamesize, mMaskBank0 + 1);
-		file_read(fp, mCartBank0, size, 1);
-		md5.update(mCartBank0, size);
+		file_read(fp, data0, size, 1);
 		gamesize -= size;
 	}
 
@@ -400,35 +397,130 @@ CCart::CCart(MDFNFILE *fp)
 	if (mMaskBank1)
    {
 		uint64 size = std::min<uint64>(gamesize, mMaskBank0 + 1);
-		file_read(fp, mCartBank1, size, 1);
-		md5.update(mCartBank1, size);
+		file_read(fp, data1, size, 1);
 	}
 
-	// As this is a cartridge boot unset the boot address
-
-	gCPUBootAddress=0;
+	for(loop=0;loop<256;loop++)
+	{
+		mPrivate0[loop]=false;
+		mPrivate1[loop]=false;
+	}
 
 	// Dont allow an empty Bank1 - Use it for shadow SRAM/EEPROM
 	if(banktype1==UNUSED)
 	{
-		// Delete the single byte allocated  earlier
-		delete[] mCartBank1;
-		// Allocate some new memory for us
+		// Always written to, so it is private to the cart from the start
 		banktype1=C64K;
 		mMaskBank1=0x00ffff;
 		mShiftCount1=8;
 		mCountMask1=0x0ff;
-		mCartBank1 = new uint8[mMaskBank1+1];
-		for(loop=0;loop<mMaskBank1+1;loop++) mCartBank1[loop]=DEFAULT_RAM_CONTENTS;
+		mPageMask1=0xff;
+		mCartRAMData = new uint8[mMaskBank1+1];
+		for(loop=0;loop<mMaskBank1+1;loop++) mCartRAMData[loop]=DEFAULT_RAM_CONTENTS;
+		for(loop=0;loop<256;loop++) mPrivate1[loop]=true;
+		data1=mCartRAMData;
 		mWriteEnableBank1=true;
 		mCartRAM=true;
 	}
+
+	SetupPages(mPages0, data0, mPageMask0, mCountMask0+1);
+	SetupPages(mPages1, data1, mPageMask1, mCountMask1+1);
+}
+
+// Create a cart with the contents of another one.  The image is shared,
+// pages the other cart has written to and the cart RAM are copied.
+CCart::CCart(const CCart &cart)
+	:CLynxBase(),
+	mWriteEnableBank0(cart.mWriteEnableBank0),
+	mWriteEnableBank1(cart.mWriteEnableBank1),
+	mCartRAM(cart.mCartRAM),
+	InfoROMSize(cart.InfoROMSize),
+	mBank(cart.mBank),
+	mMaskBank0(cart.mMaskBank0),
+	mMaskBank1(cart.mMaskBank1),
+	mPageMask0(cart.mPageMask0),
+	mPageMask1(cart.mPageMask1),
+	mImage(cart.mImage->Ref()),
+	mCartRAMData(NULL),
+	mRotation(cart.mRotation),
+	mCounter(cart.mCounter),
+	mShifter(cart.mShifter),
+	mAddrData(cart.mAddrData),
+	mStrobe(cart.mStrobe),
+	mShiftCount0(cart.mShiftCount0),
+	mCountMask0(cart.mCountMask0),
+	mShiftCount1(cart.mShiftCount1),
+	mCountMask1(cart.mCountMask1),
+	mCRC32(cart.mCRC32),
+	last_strobe(cart.last_strobe),
+	found(cart.found)
+{
+	memcpy(mName, cart.mName, sizeof(mName));
+	memcpy(mManufacturer, cart.mManufacturer, sizeof(mManufacturer));
+	memcpy(mPrivate0, cart.mPrivate0, sizeof(mPrivate0));
+	memcpy(mPrivate1, cart.mPrivate1, sizeof(mPrivate1));
+
+	for(int loop=0;loop<256;loop++)
+	{
+		if(mPrivate0[loop])
+		{
+			mPages0[loop] = new uint8[mCountMask0+1];
+			memcpy(mPages0[loop], cart.mPages0[loop], mCountMask0+1);
+		}
+		else
+			mPages0[loop] = cart.mPages0[loop];
+	}
+
+	if(cart.mCartRAMData)
+	{
+		mCartRAMData = new uint8[mMaskBank1+1];
+		memcpy(mCartRAMData, cart.mCartRAMData, mMaskBank1+1);
+		SetupPages(mPages1, mCartRAMData, mPageMask1, mCountMask1+1);
+	}
+	else
+	{
+		for(int loop=0;loop<256;loop++)
+		{
+			if(mPrivate1[loop])
+			{
+				mPages1[loop] = new uint8[mCountMask1+1];
+				memcpy(mPages1[loop], cart.mPages1[loop], mCountMask1+1);
+			}
+			else
+				mPages1[loop] = cart.mPages1[loop];
+		}
+	}
 }
 
 CCart::~CCart()
 {
-	delete[] mCartBank0;
-	delete[] mCartBank1;
+	for(int loop=0;loop<256;loop++)
+	{
+		if(mPrivate0[loop])
+			delete[] mPages0[loop];
+		if(mPrivate1[loop] && !mCartRAMData)
+			delete[] mPages1[loop];
+	}
+
+	delete[] mCartRAMData;
+
+	mImage->Release();
+}
+
+void CCart::SetupPages(uint8 **pages, uint8 *data, uint32 pagemask, uint32 pagesize)
+{
+	for(uint32 loop=0;loop<256;loop++)
+		pages[loop]=data+(loop&pagemask)*pagesize;
+}
+
+// Give the cart its own copy of a page before the first write to it
+void CCart::CopyPage(uint8 **pages, bool *priv, uint32 page, uint32 pagesize)
+{
+	uint8 *copy = new uint8[pagesize];
+
+	memcpy(copy, pages[page], pagesize);
+	pages[page]=copy;
+	priv[page]=true;
 }
 
 
@@ -445,11 +537,21 @@ INLINE void CCart::Poke(uint32 addr, uint8 data)
 {
 	if(mBank==bank0)
 	{
-		if(mWriteEnableBank0) mCartBank0[addr&mMaskBank0]=data;
+		if(mWriteEnableBank0)
+		{
+			uint32 page=((addr&mMaskBank0)>>mShiftCount0)&mPageMask0;
+			if(!mPrivate0[page]) CopyPage(mPages0, mPrivate0, page, mCountMask0+1);
+			mPages0[page][addr&mCountMask0]=data;
+		}
 	}
 	else
 	{
-		if(mWriteEnableBank1) mCartBank1[addr&mMaskBank1]=data;
+		if(mWriteEnableBank1)
+		{
+			uint32 page=((addr&mMaskBank1)>>mShiftCount1)&mPageMask1;
+			if(!mPrivate1[page]) CopyPage(mPages1, mPrivate1, page, mCountMask1+1);
+			mPages1[page][addr&mCountMask1]=data;
+		}
 	}
 }
 
@@ -458,11 +560,11 @@ INLINE uint8 CCart::Peek(uint32 addr)
 {
 	if(mBank==bank0)
 	{
-		return(mCartBank0[addr&mMaskBank0]);
+		return(mPages0[((addr&mMaskBank0)>>mShiftCount0)&mPageMask0][addr&mCountMask0]);
 	}
 	else
 	{
-		return(mCartBank1[addr&mMaskBank1]);
+		return(mPages1[((addr&mMaskBank1)>>mShiftCount1)&mPageMask1][addr&mCountMask1]);
 	}
 }
 
@@ -498,8 +600,9 @@ void CCart::Poke0(uint8 data)
 {
 	if(mWriteEnableBank0)
 	{
-		uint32 address=(mShifter<<mShiftCount0)+(mCounter&mCountMask0);
-		mCartBank0[address&mMaskBank0]=data;
+		uint32 page=mShifter&mPageMask0;
+		if(!mPrivate0[page]) CopyPage(mPages0, mPrivate0, page, mCountMask0+1);
+		mPages0[page][mCounter&mCountMask0]=data;
 	}
 	if(!mStrobe)
 	{
@@ -512,8 +615,9 @@ void CCart::Poke1(uint8 data)
 {
 	if(mWriteEnableBank1)
 	{
-		uint32 address=(mShifter<<mShiftCount1)+(mCounter&mCountMask1);
-		mCartBank1[address&mMaskBank1]=data;
+		uint32 page=mShifter&mPageMask1;
+		if(!mPrivate1[page]) CopyPage(mPages1, mPrivate1, page, mCountMask1+1);
+		mPages1[page][mCounter&mCountMask1]=data;
 	}
 	if(!mStrobe)
 	{
@@ -525,8 +629,7 @@ void CCart::Poke1(uint8 data)
 
 uint8 CCart::Peek0(void)
 {
-	uint32 address=(mShifter<<mShiftCount0)+(mCounter&mCountMask0);
-	uint8 data=mCartBank0[address&mMaskBank0];
+	uint8 data=mPages0[mShifter&mPageMask0][mCounter&mCountMask0];
 
 	if(!mStrobe)
 	{
@@ -539,8 +642,7 @@ uint8 CCart::Peek0(void)
 
 uint8 CCart::Peek1(void)
 {
-	uint32 address=(mShifter<<mShiftCount1)+(mCounter&mCountMask1);
-	uint8 data=mCartBank1[address&mMaskBank1];
+	uint8 data=mPages1[mShifter&mPageMask1][mCounter&mCountMask1];
 
 	if(!mStrobe)
 	{
@@ -568,11 +670,18 @@ int CCart::StateAction(StateMem *sm, int load, int data_only)
 		SFVAR(mWriteEnableBank0),
 		SFVAR(mWriteEnableBank1),
 	SFVAR(last_strobe),
-	SFARRAYN(mCartBank1, mCartRAM ? mMaskBank1 + 1 : 0, "mCartBank1"),
+	SFARRAYN(mCartRAMData, mCartRAMData ? mMaskBank1 + 1 : 0, "mCartBank1"),
 	SFEND
  };
  int ret = MDFNSS_StateAction(sm, load, data_only, CartRegs, "CART", false);
 
+ if(load)
+ {
+	// The page tables are laid out for this cart, keep the offsets in a page
+	mCountMask0&=mMaskBank0>>8;
+	mCountMask1&=mMaskBank1>>8;
+ }
+
 
  return(ret);
 }
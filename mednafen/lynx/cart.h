@@ -81,6 +81,7 @@ class CCart : public CLynxBase
 
 	public:
 		CCart(MDFNFILE *fp) MDFN_COLD;
+		CCart(const CCart &cart) MDFN_COLD;
 		~CCart() MDFN_COLD;
 
 	public:
@@ -127,8 +128,17 @@ class CCart : public CLynxBase
 		EMMODE	mBank;
 		uint32	mMaskBank0;
 		uint32	mMaskBank1;
-		uint8	*mCartBank0;
-		uint8	*mCartBank1;
+		uint32	mPageMask0;
+		uint32	mPageMask1;
+
+		// Each bank is 256 pages selected by the address shifter.  They
+		// point into mImage until written to, then to a private copy.
+		LynxImage	*mImage;
+		uint8	*mPages0[256];
+		uint8	*mPages1[256];
+		bool	mPrivate0[256];
+		bool	mPrivate1[256];
+		uint8	*mCartRAMData;
 		char	mName[33];
 		char	mManufacturer[17];
 		uint32	mRotation;
@@ -148,6 +158,12 @@ class CCart : public CLynxBase
 
 		bool    found;
 		LYNX_DB CheckHash(const uint32 crc32);
+
+		static void SetupPages(uint8 **pages, uint8 *data, uint32 pagemask, uint32 pagesize);
+		static void CopyPage(uint8 **pages, bool *priv, uint32 page, uint32 pagesize);
+
+		// noncopyable, the copy constructor shares the image
+		CCart& operator=(const CCart &cart);
 };
 
 #endif
@@ -35,6 +35,35 @@
 //
 enum EMMODE {bank0,bank1,ram,cpu};
 
+//
+// Read-only data loaded from a file once and shared by all the machines
+// running the same game: the cart contents, the boot ROM and the homebrew
+// image.  The last part to release it deletes it.  Not thread safe, parts
+// sharing an image must be created and deleted on one thread.
+//
+struct LynxImage
+{
+	uint32	refs;
+	uint8	*data;
+
+	static LynxImage* Create(uint32 size)
+	{
+		LynxImage *image=new LynxImage;
+		image->refs=1;
+		image->data=new uint8[size];
+		return image;
+	}
+
+	LynxImage* Ref(void) { refs++; return this; }
+	void Release(void) { if(--refs==0) { delete[] data; delete this; } }
+};
+
+//
+// Tag of the constructors that build a freshly powered up part sharing the
+// images of another one, e.g. CRom(rom,SHARE_IMAGE)
+//
+enum LynxShare {SHARE_IMAGE};
+
 class CLynxBase
 {
 	// Function members
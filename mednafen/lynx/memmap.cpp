@@ -69,6 +69,9 @@
 //
 // We can then index with mMemoryHandlers[mMemMap->mSelector][addr] for speed
 //
+// The CPU now looks $FC00-$FFFF up in CSystem::mTopPages instead, see
+// system.h, so a write here only changes a few entries.
+//
 
 CMemMap::CMemMap(CSystem& parent)
 	:mSystem(parent)
@@ -79,13 +82,14 @@ CMemMap::CMemMap(CSystem& parent)
 
 void CMemMap::Reset(void)
 {
+	uint8 *ram=mSystem.mRam->GetRamPointer();
 
-	// Initialise ALL pointers to RAM then overload to correct
-	for(int loop=0;loop<SYSTEM_SIZE;loop++) mSystem.mMemoryHandlers[loop]=mSystem.mRam;
+	// Initialise ALL entries to RAM then overload to correct
+	for(uint32 loop=TOP_START;loop<TOP_FIXED_START;loop+=0x100) SetTopPage(loop,ram+(loop&0xff00),ram+(loop&0xff00),TOP_IO_RAM);
+	for(uint32 loop=TOP_FIXED_START;loop<=0xffff;loop++) SetTopPage(loop,ram+0xff00,ram+0xff00,TOP_IO_RAM);
 
 	// Special case for ourselves.
-	mSystem.mMemoryHandlers[0xFFF8]=mSystem.mRam;
-	mSystem.mMemoryHandlers[0xFFF9]=mSystem.mMemMap;
+	SetTopPage(0xFFF9,NULL,NULL,TOP_IO_MEMMAP);
 
 	mSusieEnabled=-1;
 	mMikieEnabled=-1;
@@ -97,9 +101,24 @@ void CMemMap::Reset(void)
 
 }
 
+//
+// Points the page table entry of 'addr' at plain memory or a handler, the
+// pointers are for the start of the 256 byte page
+//
+inline void CMemMap::SetTopPage(uint32 addr, uint8 *read, uint8 *write, uint32 handler)
+{
+	LynxTopPage &page=mSystem.TopPage(addr);
+
+	page.read=read;
+	page.write=write;
+	page.handler=handler;
+}
+
 
-INLINE void CMemMap::Poke(uint32 addr, uint8 data)
+void CMemMap::Poke(uint32 addr, uint8 data)
 {
+	uint8 *ram=mSystem.mRam->GetRamPointer();
+	uint8 *rom=mSystem.mRom->GetRomPointer();
 	int newstate,loop;
 
 	// FC00-FCFF Susie area
@@ -110,11 +129,11 @@ INLINE void CMemMap::Poke(uint32 addr, uint8 data)
 
 		if(mSusieEnabled)
 		{
-			for(loop=SUSIE_START;loop<SUSIE_START+SUSIE_SIZE;loop++) mSystem.mMemoryHandlers[loop]=mSystem.mSusie;
+			SetTopPage(SUSIE_START,NULL,NULL,TOP_IO_SUSIE);
 		}
 		else
 		{
-			for(loop=SUSIE_START;loop<SUSIE_START+SUSIE_SIZE;loop++) mSystem.mMemoryHandlers[loop]=mSystem.mRam;
+			SetTopPage(SUSIE_START,ram+SUSIE_START,ram+SUSIE_START,TOP_IO_RAM);
 		}
 	}
 
@@ -126,15 +145,15 @@ INLINE void CMemMap::Poke(uint32 addr, uint8 data)
 
 		if(mMikieEnabled)
 		{
-			for(loop=MIKIE_START;loop<MIKIE_START+MIKIE_SIZE;loop++) mSystem.mMemoryHandlers[loop]=mSystem.mMikie;
+			SetTopPage(MIKIE_START,NULL,NULL,TOP_IO_MIKIE);
 		}
 		else
 		{
-			for(loop=MIKIE_START;loop<MIKIE_START+MIKIE_SIZE;loop++) mSystem.mMemoryHandlers[loop]=mSystem.mRam;
+			SetTopPage(MIKIE_START,ram+MIKIE_START,ram+MIKIE_START,TOP_IO_RAM);
 		}
 	}
 
-	// FE00-FFF7 Rom area
+	// FE00-FFF7 Rom area, writes go to the ROM which ignores them
 	newstate=(data&0x04)?false:true;
 	if(newstate!=mRomEnabled)
 	{
@@ -142,11 +161,13 @@ INLINE void CMemMap::Poke(uint32 addr, uint8 data)
 
 		if(mRomEnabled)
 		{
-			for(loop=BROM_START;loop<BROM_START+(BROM_SIZE-8);loop++) mSystem.mMemoryHandlers[loop]=mSystem.mRom;
+			SetTopPage(BROM_START,rom,NULL,TOP_IO_ROM);
+			SetTopPage(BROM_START+0x100,rom+0x100,NULL,TOP_IO_ROM);
 		}
 		else
 		{
-			for(loop=BROM_START;loop<BROM_START+(BROM_SIZE-8);loop++) mSystem.mMemoryHandlers[loop]=mSystem.mRam;
+			SetTopPage(BROM_START,ram+BROM_START,ram+BROM_START,TOP_IO_RAM);
+			SetTopPage(BROM_START+0x100,ram+BROM_START+0x100,ram+BROM_START+0x100,TOP_IO_RAM);
 		}
 	}
 
@@ -158,18 +179,18 @@ INLINE void CMemMap::Poke(uint32 addr, uint8 data)
 
 		if(mVectorsEnabled)
 		{
-			for(loop=VECTOR_START;loop<VECTOR_START+VECTOR_SIZE;loop++) mSystem.mMemoryHandlers[loop]=mSystem.mRom;
+			for(loop=VECTOR_START;loop<VECTOR_START+VECTOR_SIZE;loop++) SetTopPage(loop,rom+0x100,NULL,TOP_IO_ROM);
 		}
 		else
 		{
-			for(loop=VECTOR_START;loop<VECTOR_START+VECTOR_SIZE;loop++) mSystem.mMemoryHandlers[loop]=mSystem.mRam;
+			for(loop=VECTOR_START;loop<VECTOR_START+VECTOR_SIZE;loop++) SetTopPage(loop,ram+0xff00,ram+0xff00,TOP_IO_RAM);
 		}
 	}
 
 
 }
 
-INLINE uint8 CMemMap::Peek(uint32 addr)
+uint8 CMemMap::Peek(uint32 addr)
 {
 	uint8 retval=0;
 
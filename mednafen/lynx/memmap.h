@@ -65,6 +65,9 @@ class CMemMap : public CLynxBase
 		uint32	ObjectSize(void) {return MEMMAP_SIZE;};
 		int	StateAction(StateMem *sm, int load, int data_only);
 
+	private:
+		void	SetTopPage(uint32 addr,uint8 *read,uint8 *write,uint32 handler);
+
 	// Data members
 
 	private:
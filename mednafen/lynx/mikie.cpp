@@ -50,6 +50,32 @@
 #include "system.h"
 #include "mikie.h"
 #include "lynxdef.h"
+#include "perf.h"
+
+// Line conversion with byte shuffles.  The 16 colours fit in one register per
+// byte of the output pixel, SSE2 alone has no shuffle that can index them.
+// Unless built for SSSE3 (NEED_SSSE3=1 passes -mssse3) the shuffle code is
+// compiled for it on its own and only used when the CPU reports SSSE3.
+#if defined(__SSSE3__) && !defined(MSB_FIRST)
+#define MIKIE_LINE_SSSE3
+#define MIKIE_SSSE3_TARGET
+#include <tmmintrin.h>
+#elif (defined(__x86_64__) || defined(__i386__)) && !defined(MSB_FIRST) && \
+	(defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define MIKIE_LINE_SSSE3
+#define MIKIE_LINE_DISPATCH
+#define MIKIE_SSSE3_TARGET __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#elif (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER)
+#define MIKIE_LINE_SSSE3
+#define MIKIE_LINE_DISPATCH
+#define MIKIE_SSSE3_TARGET
+#include <intrin.h>
+#include <tmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON) && !defined(MSB_FIRST)
+#define MIKIE_LINE_NEON
+#include <arm_neon.h>
+#endif
 
 
 void CMikie::BlowOut(void)
@@ -58,15 +84,27 @@ void CMikie::BlowOut(void)
 	mSystem.GetRegs(regs);
 	//sprintf(addr,"Runtime Error - System Halted\nCMikie::Poke() - Read/Write to counter clocks at PC=$%04x.",regs.PC);
 	//gError->Warning(addr);
-	gSystemHalt=true;
+	mState.SystemHalt=true;
 }
 
 
 CMikie::CMikie(CSystem& parent)
-	:mSystem(parent)
+	:mSystem(parent),
+	mState(parent.mState)
 {
 	mpDisplayCurrent=NULL;
 	mpRamPointer=NULL;
+	mpSkipFrame=false;
+	mpSkipSound=false;
+	mpDisplayStale=true;
+	mFramePaletteCount=0;
+	mPaletteSerial=0;
+	memset(&mPaletteOut,0,sizeof(mPaletteOut));
+	memset(mLineSerial,0,sizeof(mLineSerial));
+	mFrameChanged=true;
+	mLastFrameLines=0;
+	last_lsample=0;
+	last_rsample=0;
 
 	mUART_CABLE_PRESENT=false;
 	mpUART_TX_CALLBACK=NULL;
@@ -224,6 +262,7 @@ void CMikie::Reset(void)
 	{
 		mPalette[loop].Index=loop;
 	}
+	UpdatePaletteHost();
 
 	// Initialise IODAT register
 
@@ -390,67 +429,313 @@ void CMikie::DisplaySetAttributes(int32 bpp)
 		  break;
 	  }
 	}
+	UpdatePaletteHost();
+}
+
+void CMikie::UpdatePen(uint32 pen)
+{
+	uint32 colour=mColourMap[mPalette[pen].Index];
+	uint16 lynx=(uint16)mPalette[pen].Index;
+
+	if(colour==mPaletteOut.host[pen] && lynx==mPaletteOut.lynx[pen])
+		return;
+
+	mPaletteOut.host[pen]=colour;
+	for(int plane=0;plane<4;plane++)
+		mPaletteOut.planes[plane][pen]=(uint8)(colour>>(plane*8));
+	mPaletteOut.lynx[pen]=lynx;
+	mPaletteChanged=true;
+	mPaletteSerial++;
+}
+
+void CMikie::UpdatePaletteHost(void)
+{
+	for(uint32 pen=0;pen<16;pen++)
+		UpdatePen(pen);
+}
+
+#if defined(MIKIE_LINE_SSSE3)
+
+// 16 pen numbers to 16 pixels, each byte of the pixel looked up in its plane
+MIKIE_SSSE3_TARGET static INLINE void LinePens16(__m128i pens, const uint8 (*planes)[16], uint16 *out)
+{
+	__m128i lo=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)planes[0]),pens);
+	__m128i hi=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)planes[1]),pens);
+
+	_mm_storeu_si128((__m128i*)out,_mm_unpacklo_epi8(lo,hi));
+	_mm_storeu_si128((__m128i*)(out+8),_mm_unpackhi_epi8(lo,hi));
+}
+
+MIKIE_SSSE3_TARGET static INLINE void LinePens32(__m128i pens, const uint8 (*planes)[16], uint32 *out)
+{
+	__m128i b0=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)planes[0]),pens);
+	__m128i b1=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)planes[1]),pens);
+	__m128i b2=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)planes[2]),pens);
+	__m128i b3=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)planes[3]),pens);
+	__m128i lo=_mm_unpacklo_epi8(b0,b1);
+	__m128i hi=_mm_unpacklo_epi8(b2,b3);
+
+	_mm_storeu_si128((__m128i*)out,_mm_unpacklo_epi16(lo,hi));
+	_mm_storeu_si128((__m128i*)(out+4),_mm_unpackhi_epi16(lo,hi));
+	lo=_mm_unpackhi_epi8(b0,b1);
+	hi=_mm_unpackhi_epi8(b2,b3);
+	_mm_storeu_si128((__m128i*)(out+8),_mm_unpacklo_epi16(lo,hi));
+	_mm_storeu_si128((__m128i*)(out+12),_mm_unpackhi_epi16(lo,hi));
 }
 
-void CMikie::CopyLineSurface(int32 bpp)
+// 'src' is the first byte of the line, the last one when flipped. A flipped
+// line is read backwards and shows the low nibble of each byte first.
+MIKIE_SSSE3_TARGET static void LineConvert(const uint8 *src, bool flip, int32 bpp, const uint8 (*planes)[16], void *dst)
 {
-	if(mpDisplayCurrentLine > 102)
+	const __m128i mask=_mm_set1_epi8(0x0f);
+	const __m128i reverse=_mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+
+	for(int chunk=0;chunk<SCREEN_WIDTH/32;chunk++)
 	{
-	 printf("Lynx Line Overflow: %d\n", mpDisplayCurrentLine);
-	 return;
+		__m128i bytes,first,second,pens0,pens1;
+
+		if(flip)
+		{
+			bytes=_mm_loadu_si128((const __m128i*)(src-chunk*16-15));
+			bytes=_mm_shuffle_epi8(bytes,reverse);
+			first=_mm_and_si128(bytes,mask);
+			second=_mm_and_si128(_mm_srli_epi16(bytes,4),mask);
+		}
+		else
+		{
+			bytes=_mm_loadu_si128((const __m128i*)(src+chunk*16));
+			first=_mm_and_si128(_mm_srli_epi16(bytes,4),mask);
+			second=_mm_and_si128(bytes,mask);
+		}
+		pens0=_mm_unpacklo_epi8(first,second);
+		pens1=_mm_unpackhi_epi8(first,second);
+
+		if(bpp==16)
+		{
+			LinePens16(pens0,planes,(uint16*)dst+chunk*32);
+			LinePens16(pens1,planes,(uint16*)dst+chunk*32+16);
+		}
+		else
+		{
+			LinePens32(pens0,planes,(uint32*)dst+chunk*32);
+			LinePens32(pens1,planes,(uint32*)dst+chunk*32+16);
+		}
 	}
+}
 
-	switch (bpp)
-	{
-	case 16:
+static bool LineConvertUsable(void)
+{
+#if !defined(MIKIE_LINE_DISPATCH)
+	return true;
+#elif defined(_MSC_VER)
+	int info[4];
+
+	__cpuid(info,1);
+	return (info[2]&(1<<9))!=0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("ssse3")!=0;
+#endif
+}
+
+#elif defined(MIKIE_LINE_NEON)
+
+static void LineConvert(const uint8 *src, bool flip, int32 bpp, const uint8 (*planes)[16], void *dst)
+{
+	const uint8x16_t mask=vdupq_n_u8(0x0f);
+	uint8x16x4_t pal;
+
+	pal.val[0]=vld1q_u8(planes[0]);
+	pal.val[1]=vld1q_u8(planes[1]);
+	pal.val[2]=vld1q_u8(planes[2]);
+	pal.val[3]=vld1q_u8(planes[3]);
+
+	for(int chunk=0;chunk<SCREEN_WIDTH/32;chunk++)
 	{
-		uint16 *bitmap_tmp = mpDisplayCurrent->pixels + mpDisplayCurrentLine * mpDisplayCurrent->pitch;
-		for (uint32 loop = 0; loop < SCREEN_WIDTH / 2; loop++)
+		uint8x16_t bytes,first,second,pens[2];
+
+		if(flip)
+		{
+			bytes=vld1q_u8(src-chunk*16-15);
+			bytes=vrev64q_u8(bytes);
+			bytes=vextq_u8(bytes,bytes,8);
+			first=vandq_u8(bytes,mask);
+			second=vshrq_n_u8(bytes,4);
+		}
+		else
 		{
-			uint32 source = mpRamPointer[(uint16)mLynxAddr];
-			if (mDISPCTL_Flip)
+			bytes=vld1q_u8(src+chunk*16);
+			first=vshrq_n_u8(bytes,4);
+			second=vandq_u8(bytes,mask);
+		}
+		pens[0]=vzip1q_u8(first,second);
+		pens[1]=vzip2q_u8(first,second);
+
+		for(int half=0;half<2;half++)
+		{
+			if(bpp==16)
 			{
-				mLynxAddr--;
-				*bitmap_tmp = mColourMap[mPalette[source & 0x0f].Index];
-				bitmap_tmp++;
-				*bitmap_tmp = mColourMap[mPalette[source >> 4].Index];
-				bitmap_tmp++;
+				uint8x16x2_t out;
+
+				out.val[0]=vqtbl1q_u8(pal.val[0],pens[half]);
+				out.val[1]=vqtbl1q_u8(pal.val[1],pens[half]);
+				vst2q_u8((uint8*)((uint16*)dst+chunk*32+half*16),out);
 			}
 			else
 			{
-				mLynxAddr++;
-				*bitmap_tmp = mColourMap[mPalette[source >> 4].Index];
-				bitmap_tmp++;
-				*bitmap_tmp = mColourMap[mPalette[source & 0x0f].Index];
-				bitmap_tmp++;
+				uint8x16x4_t out;
+
+				out.val[0]=vqtbl1q_u8(pal.val[0],pens[half]);
+				out.val[1]=vqtbl1q_u8(pal.val[1],pens[half]);
+				out.val[2]=vqtbl1q_u8(pal.val[2],pens[half]);
+				out.val[3]=vqtbl1q_u8(pal.val[3],pens[half]);
+				vst4q_u8((uint8*)((uint32*)dst+chunk*32+half*16),out);
 			}
 		}
-		break;
 	}
-	case 32:
+}
+
+static bool LineConvertUsable(void)
+{
+	return true;
+}
+
+#endif
+
+template<typename T>
+static INLINE void LineConvertScalar(const uint8 *src, bool flip, const uint32 *palette, T *out)
+{
+	if(flip)
 	{
-		uint32 *bitmap_tmp = (uint32 *)mpDisplayCurrent->pixels + mpDisplayCurrentLine * mpDisplayCurrent->pitch;
-		for (uint32 loop = 0; loop < SCREEN_WIDTH / 2; loop++)
+		for(uint32 loop=0;loop<SCREEN_WIDTH/2;loop++)
 		{
-			uint32 source = mpRamPointer[(uint16)mLynxAddr];
-			if (mDISPCTL_Flip)
-			{
-				mLynxAddr--;
-				*bitmap_tmp = mColourMap[mPalette[source & 0x0f].Index];
-				bitmap_tmp++;
-				*bitmap_tmp = mColourMap[mPalette[source >> 4].Index];
-				bitmap_tmp++;
-			}
-			else
-			{
-				mLynxAddr++;
-				*bitmap_tmp = mColourMap[mPalette[source >> 4].Index];
-				bitmap_tmp++;
-				*bitmap_tmp = mColourMap[mPalette[source & 0x0f].Index];
-				bitmap_tmp++;
-			}
+			uint32 source=*src--;
+			*out++=palette[source&0x0f];
+			*out++=palette[source>>4];
 		}
 	}
+	else
+	{
+		for(uint32 loop=0;loop<SCREEN_WIDTH/2;loop++)
+		{
+			uint32 source=*src++;
+			*out++=palette[source>>4];
+			*out++=palette[source&0x0f];
+		}
+	}
+}
+
+//
+// Lines are not converted when the DMA reads them.  The 80 bytes of the line
+// and the palette in use are kept, and DisplayConvertFrame() turns all of
+// them into pixels once the frame is done.  A palette is only stored again
+// when it changed since the line before.  The conversion runs on the
+// emulation thread: a 160x102 frame takes a few microseconds, no more than
+// handing it to another thread, and batch machines already keep every
+// thread of the pool busy.
+//
+void CMikie::CaptureLine(void)
+{
+	uint32 line=mpDisplayCurrentLine;
+
+	// Lines past the bottom of the screen are never shown
+	if(line >= 102)
+	 return;
+
+	if(line==0)
+	{
+		mFramePaletteCount=0;
+		mFrameChanged=false;
+	}
+
+	if(line==0 || mPaletteChanged)
+	{
+		mFramePalettes[mFramePaletteCount++]=mPaletteOut;
+		mPaletteChanged=false;
+	}
+	mLinePalette[line]=mFramePaletteCount-1;
+
+	// Note whether the line looks any different from the frame before
+	uint8 flip=mDISPCTL_Flip ? 1 : 0;
+
+	if(mLineFlip[line]!=flip || mLineSerial[line]!=mPaletteSerial)
+		mFrameChanged=true;
+	mLineFlip[line]=flip;
+	mLineSerial[line]=mPaletteSerial;
+
+	// The pens are kept in address order, a flipped line ends at mLynxAddr
+	uint16 addr=(uint16)mLynxAddr;
+
+	if(mDISPCTL_Flip)
+	{
+		addr-=SCREEN_WIDTH/2-1;
+		mLynxAddr-=SCREEN_WIDTH/2;
+	}
+	else
+		mLynxAddr+=SCREEN_WIDTH/2;
+
+	if(addr<=0x10000-SCREEN_WIDTH/2)
+	{
+		if(!mFrameChanged && memcmp(mLinePens[line],mpRamPointer+addr,SCREEN_WIDTH/2))
+			mFrameChanged=true;
+		memcpy(mLinePens[line],mpRamPointer+addr,SCREEN_WIDTH/2);
+	}
+	else
+	{
+		uint8 pens[SCREEN_WIDTH/2];
+		uint32 head=0x10000-addr;
+
+		memcpy(pens,mpRamPointer+addr,head);
+		memcpy(pens+head,mpRamPointer,SCREEN_WIDTH/2-head);
+		if(memcmp(mLinePens[line],pens,SCREEN_WIDTH/2))
+			mFrameChanged=true;
+		memcpy(mLinePens[line],pens,SCREEN_WIDTH/2);
+	}
+}
+
+bool CMikie::DisplayFrameChanged(void)
+{
+	uint32 lines=mpDisplayCurrentLine<102 ? mpDisplayCurrentLine : 102;
+	bool changed=mFrameChanged || lines!=mLastFrameLines;
+
+	mLastFrameLines=lines;
+	return changed;
+}
+
+void CMikie::DisplayConvertFrame(MDFN_Surface *surface)
+{
+	int32 bpp=surface->bpp;
+
+	if(bpp!=16 && bpp!=32)
+	 return;
+
+#if defined(MIKIE_LINE_SSSE3) || defined(MIKIE_LINE_NEON)
+	static const bool simd=LineConvertUsable();
+#endif
+
+	for(int line=0;line<102;line++)
+	{
+		if(!mLineDrawn[line])
+			continue;
+
+		const MikiePalette *palette=&mFramePalettes[mLinePalette[line]];
+		bool flip=mLineFlip[line];
+		const uint8 *src=flip ? mLinePens[line]+SCREEN_WIDTH/2-1 : mLinePens[line];
+
+#if defined(MIKIE_LINE_SSSE3) || defined(MIKIE_LINE_NEON)
+		if(simd)
+		{
+			if(bpp==16)
+				LineConvert(src,flip,bpp,palette->planes,surface->pixels+line*surface->pitch);
+			else
+				LineConvert(src,flip,bpp,palette->planes,(uint32*)surface->pixels+line*surface->pitch);
+			continue;
+		}
+#endif
+		if(bpp==16)
+			LineConvertScalar(src,flip,palette->host,surface->pixels+line*surface->pitch);
+		else
+			LineConvertScalar(src,flip,palette->host,(uint32*)surface->pixels+line*surface->pitch);
 	}
 }
 
@@ -505,10 +790,12 @@ uint32 CMikie::DisplayRenderLine(void)
 		// Assign the temporary pointer;
 		if(!mpSkipFrame)
 		{
-	        CopyLineSurface(mpDisplayCurrent->bpp);
+			PERF_START(PERF_LINE);
+			CaptureLine();
+			PERF_STOP(PERF_LINE);
 
 			if(mpDisplayCurrentLine < 102)
-			 LynxLineDrawn[mpDisplayCurrentLine] = true;
+			 mLineDrawn[mpDisplayCurrentLine] = true;
 
 			mpDisplayCurrentLine++;
 		}
@@ -527,6 +814,9 @@ uint32 CMikie::DisplayEndOfFrame(void)
 		mTimerStatusFlags|=0x04;
 
 	mpDisplayCurrent = NULL;
+
+	// The frame may end inside a CPU batch via a timer counter read
+	mSystem.mCpu->Break();
 	return 0;
 }
 
@@ -542,25 +832,25 @@ void CMikie::Poke(uint32 addr,uint8 data)
 	 {
                 case (AUD0VOL&0x7):
                         mAUDIO_VOLUME[which]=(int8)data;
-                        CombobulateSound(gSystemCycleCount - startTS);
+                        CombobulateSound(mState.SystemCycleCount - startTS);
                         break;
                 case (AUD0SHFTFB&0x7):
                         mAUDIO_WAVESHAPER[which]&=0x001fff;
                         mAUDIO_WAVESHAPER[which]|=(uint32)data<<13;
-                        CombobulateSound(gSystemCycleCount - startTS);
+                        CombobulateSound(mState.SystemCycleCount - startTS);
                         break;
                 case (AUD0OUTVAL&0x7):
                         mAUDIO_OUTPUT[which]=data;
-                        CombobulateSound(gSystemCycleCount - startTS);
+                        CombobulateSound(mState.SystemCycleCount - startTS);
                         break;
                 case (AUD0L8SHFT&0x7):
                         mAUDIO_WAVESHAPER[which]&=0x1fff00;
                         mAUDIO_WAVESHAPER[which]|=data;
-                        CombobulateSound(gSystemCycleCount - startTS);
+                        CombobulateSound(mState.SystemCycleCount - startTS);
                         break;
                 case (AUD0TBACK&0x7):
                         mAUDIO_BKUP[which]=data;
-                        CombobulateSound(gSystemCycleCount - startTS);
+                        CombobulateSound(mState.SystemCycleCount - startTS);
                         break;
                 case (AUD0CTL&0x7):
                         mAUDIO_ENABLE_RELOAD[which]=data&0x10;
@@ -572,14 +862,14 @@ void CMikie::Poke(uint32 addr,uint8 data)
                         mAUDIO_WAVESHAPER[which]|=(data&0x80)?0x001000:0x000000;
                         if(data&0x48)
                         {
-                                mAUDIO_LAST_COUNT[which]=gSystemCycleCount;
-                                gNextTimerEvent=gSystemCycleCount;
+                                mAUDIO_LAST_COUNT[which]=mState.SystemCycleCount;
+                                mState.NextTimerEvent=mState.SystemCycleCount;
                         }
-                        CombobulateSound(gSystemCycleCount - startTS);
+                        CombobulateSound(mState.SystemCycleCount - startTS);
                         break;
                 case (AUD0COUNT&0x7):
                         mAUDIO_CURRENT[which]=data;
-                        CombobulateSound(gSystemCycleCount - startTS);
+                        CombobulateSound(mState.SystemCycleCount - startTS);
                         break;
                 case (AUD0MISC&0x7):
                         mAUDIO_WAVESHAPER[which]&=0x1ff0ff;
@@ -587,7 +877,7 @@ void CMikie::Poke(uint32 addr,uint8 data)
                         mAUDIO_BORROW_IN[which]=data&0x02;
                         mAUDIO_BORROW_OUT[which]=data&0x01;
                         mAUDIO_LAST_CLOCK[which]=data&0x04;
-                        CombobulateSound(gSystemCycleCount - startTS);
+                        CombobulateSound(mState.SystemCycleCount - startTS);
                         break;
 	 }
 	}
@@ -628,8 +918,8 @@ void CMikie::Poke(uint32 addr,uint8 data)
 			if(data&0x40) mTIM_0_TIMER_DONE=0;
 			if(data&0x48)
 			{
-				mTIM_0_LAST_COUNT=gSystemCycleCount;
-				gNextTimerEvent=gSystemCycleCount;
+				mTIM_0_LAST_COUNT=mState.SystemCycleCount;
+				mState.NextTimerEvent=mState.SystemCycleCount;
 			}
 			break;
 		case (TIM1CTLA&0xff): 
@@ -641,8 +931,8 @@ void CMikie::Poke(uint32 addr,uint8 data)
 			if(data&0x40) mTIM_1_TIMER_DONE=0;
 			if(data&0x48)
 			{
-				mTIM_1_LAST_COUNT=gSystemCycleCount;
-				gNextTimerEvent=gSystemCycleCount;
+				mTIM_1_LAST_COUNT=mState.SystemCycleCount;
+				mState.NextTimerEvent=mState.SystemCycleCount;
 			}
 			break;
 		case (TIM2CTLA&0xff): 
@@ -654,8 +944,8 @@ void CMikie::Poke(uint32 addr,uint8 data)
 			if(data&0x40) mTIM_2_TIMER_DONE=0;
 			if(data&0x48)
 			{
-				mTIM_2_LAST_COUNT=gSystemCycleCount;
-				gNextTimerEvent=gSystemCycleCount;
+				mTIM_2_LAST_COUNT=mState.SystemCycleCount;
+				mState.NextTimerEvent=mState.SystemCycleCount;
 			}
 			break;
 		case (TIM3CTLA&0xff): 
@@ -667,8 +957,8 @@ void CMikie::Poke(uint32 addr,uint8 data)
 			if(data&0x40) mTIM_3_TIMER_DONE=0;
 			if(data&0x48)
 			{
-				mTIM_3_LAST_COUNT=gSystemCycleCount;
-				gNextTimerEvent=gSystemCycleCount;
+				mTIM_3_LAST_COUNT=mState.SystemCycleCount;
+				mState.NextTimerEvent=mState.SystemCycleCount;
 			}
 			break;
 		case (TIM4CTLA&0xff): 
@@ -680,8 +970,8 @@ void CMikie::Poke(uint32 addr,uint8 data)
 			if(data&0x40) mTIM_4_TIMER_DONE=0;
 			if(data&0x48)
 			{
-				mTIM_4_LAST_COUNT=gSystemCycleCount;
-				gNextTimerEvent=gSystemCycleCount;
+				mTIM_4_LAST_COUNT=mState.SystemCycleCount;
+				mState.NextTimerEvent=mState.SystemCycleCount;
 			}
 			break;
 		case (TIM5CTLA&0xff): 
@@ -693,8 +983,8 @@ void CMikie::Poke(uint32 addr,uint8 data)
 			if(data&0x40) mTIM_5_TIMER_DONE=0;
 			if(data&0x48)
 			{
-				mTIM_5_LAST_COUNT=gSystemCycleCount;
-				gNextTimerEvent=gSystemCycleCount;
+				mTIM_5_LAST_COUNT=mState.SystemCycleCount;
+				mState.NextTimerEvent=mState.SystemCycleCount;
 			}
 			break;
 		case (TIM6CTLA&0xff): 
@@ -706,8 +996,8 @@ void CMikie::Poke(uint32 addr,uint8 data)
 			if(data&0x40) mTIM_6_TIMER_DONE=0;
 			if(data&0x48)
 			{
-				mTIM_6_LAST_COUNT=gSystemCycleCount;
-				gNextTimerEvent=gSystemCycleCount;
+				mTIM_6_LAST_COUNT=mState.SystemCycleCount;
+				mState.NextTimerEvent=mState.SystemCycleCount;
 			}
 			break;
 		case (TIM7CTLA&0xff):
@@ -719,43 +1009,43 @@ void CMikie::Poke(uint32 addr,uint8 data)
 			if(data&0x40) mTIM_7_TIMER_DONE=0;
 			if(data&0x48)
 			{
-				mTIM_7_LAST_COUNT=gSystemCycleCount;
-				gNextTimerEvent=gSystemCycleCount;
+				mTIM_7_LAST_COUNT=mState.SystemCycleCount;
+				mState.NextTimerEvent=mState.SystemCycleCount;
 			}
 			break;
 
 
 		case (TIM0CNT&0xff): 
 			mTIM_0_CURRENT=data;
-			gNextTimerEvent=gSystemCycleCount;
+			mState.NextTimerEvent=mState.SystemCycleCount;
 			break;
 		case (TIM1CNT&0xff): 
 			mTIM_1_CURRENT=data;
-			gNextTimerEvent=gSystemCycleCount;
+			mState.NextTimerEvent=mState.SystemCycleCount;
 			break;
 		case (TIM2CNT&0xff): 
 			mTIM_2_CURRENT=data;
-			gNextTimerEvent=gSystemCycleCount;
+			mState.NextTimerEvent=mState.SystemCycleCount;
 			break;
 		case (TIM3CNT&0xff): 
 			mTIM_3_CURRENT=data;
-			gNextTimerEvent=gSystemCycleCount;
+			mState.NextTimerEvent=mState.SystemCycleCount;
 			break;
 		case (TIM4CNT&0xff): 
 			mTIM_4_CURRENT=data;
-			gNextTimerEvent=gSystemCycleCount;
+			mState.NextTimerEvent=mState.SystemCycleCount;
 			break;
 		case (TIM5CNT&0xff): 
 			mTIM_5_CURRENT=data;
-			gNextTimerEvent=gSystemCycleCount;
+			mState.NextTimerEvent=mState.SystemCycleCount;
 			break;
 		case (TIM6CNT&0xff): 
 			mTIM_6_CURRENT=data;
-			gNextTimerEvent=gSystemCycleCount;
+			mState.NextTimerEvent=mState.SystemCycleCount;
 			break;
 		case (TIM7CNT&0xff): 
 			mTIM_7_CURRENT=data;
-			gNextTimerEvent=gSystemCycleCount;
+			mState.NextTimerEvent=mState.SystemCycleCount;
 			break;
 
 		case (TIM0CTLB&0xff): 
@@ -817,40 +1107,40 @@ void CMikie::Poke(uint32 addr,uint8 data)
 
 		case (ATTEN_A&0xff):
             mAUDIO_ATTEN[0] = data;
-            CombobulateSound(gSystemCycleCount - startTS);
+            CombobulateSound(mState.SystemCycleCount - startTS);
             break;
 		case (ATTEN_B&0xff):
             mAUDIO_ATTEN[1] = data;
-            CombobulateSound(gSystemCycleCount - startTS);
+            CombobulateSound(mState.SystemCycleCount - startTS);
             break;
 		case (ATTEN_C&0xff):
             mAUDIO_ATTEN[2] = data;
-            CombobulateSound(gSystemCycleCount - startTS);
+            CombobulateSound(mState.SystemCycleCount - startTS);
             break;
 		case (ATTEN_D&0xff):
             mAUDIO_ATTEN[3] = data;
-            CombobulateSound(gSystemCycleCount - startTS);
+            CombobulateSound(mState.SystemCycleCount - startTS);
             break;
 		case (MPAN&0xff):
 			mPAN = data;
-			CombobulateSound(gSystemCycleCount - startTS);
+			CombobulateSound(mState.SystemCycleCount - startTS);
 			break;
 
 		case (MSTEREO&0xff):
 			data^=0xff;
 			mSTEREO=data;
-			CombobulateSound(gSystemCycleCount - startTS);
+			CombobulateSound(mState.SystemCycleCount - startTS);
 			break;
 
 		case (INTRST&0xff):
 			data^=0xff;
 			mTimerStatusFlags&=data;
-			gNextTimerEvent=gSystemCycleCount;
+			mState.NextTimerEvent=mState.SystemCycleCount;
 			break;
 
 		case (INTSET&0xff): 
 			mTimerStatusFlags|=data;
-			gNextTimerEvent=gSystemCycleCount;
+			mState.NextTimerEvent=mState.SystemCycleCount;
 			break;
 
 		case (SYSCTL1&0xff):
@@ -860,7 +1150,7 @@ void CMikie::Poke(uint32 addr,uint8 data)
 				mSystem.GetRegs(regs);
 				MDFN_printf("Runtime Alert - System Halted\nCMikie::Poke(SYSCTL1) - Lynx power down occurred at PC=$%04x.\nResetting system.\n",regs.PC);
 				mSystem.Reset();
-				gSystemHalt=true;
+				mState.SystemHalt=true;
 			}
 			mSystem.CartAddressStrobe((data&0x01)?true:false);
 			break;
@@ -930,7 +1220,9 @@ void CMikie::Poke(uint32 addr,uint8 data)
 		case (SDONEACK&0xff):
 			break;
 		case (CPUSLEEP&0xff):
-			gSuzieDoneTime = gSystemCycleCount+mSystem.PaintSprites();
+			PERF_START(PERF_SPRITES);
+			mState.SuzieDoneTime = mState.SystemCycleCount+mSystem.PaintSprites();
+			PERF_STOP(PERF_SPRITES);
 			SetCPUSleep();
 			break;
 
@@ -984,6 +1276,7 @@ void CMikie::Poke(uint32 addr,uint8 data)
 		case (GREENE&0xff): 
 		case (GREENF&0xff):
 			mPalette[addr&0x0f].Colours.Green=data&0x0f;
+			UpdatePen(addr&0x0f);
 			break;
 
 		case (BLUERED0&0xff): 
@@ -1004,6 +1297,7 @@ void CMikie::Poke(uint32 addr,uint8 data)
 		case (BLUEREDF&0xff): 
 			mPalette[addr&0x0f].Colours.Blue=(data&0xf0)>>4;
 			mPalette[addr&0x0f].Colours.Red=data&0x0f;
+			UpdatePen(addr&0x0f);
 			break;
 
 // Errors on read only register accesses
@@ -1638,19 +1932,21 @@ int CMikie::StateAction(StateMem *sm, int load, int data_only)
 
 	if(load)
 	{
-
-
-
+		UpdatePaletteHost();
 	}
         return ret;
 }
 
 void CMikie::CombobulateSound(uint32 teatime)
 {
+                                // Nothing is mixed while the sound is thrown away.  The last levels
+                                // stay as they were, so the first change afterwards steps the
+                                // output straight to the new level.
+                                if(mpSkipSound)
+                                  return;
+
                                 int cur_lsample = 0;
                                 int cur_rsample = 0;
-                                static int last_lsample = 0;
-                                static int last_rsample = 0;
                                 int x;
 
                                 teatime >>= 2;
@@ -1695,15 +1991,17 @@ void CMikie::Update(void)
 			uint32 tmp;
 			uint32 mikie_work_done=0;
 
+			PERF_START(PERF_TIMERS);
+
 			//
 			// To stop problems with cycle count wrap we will check and then correct the
 			// cycle counter.
 			//
 
 
-			if(gSystemCycleCount>0xf0000000)
+			if(mState.SystemCycleCount>0xf0000000)
 			{
-				gSystemCycleCount-=0x80000000;
+				mState.SystemCycleCount-=0x80000000;
 				mTIM_0_LAST_COUNT-=0x80000000;
 				mTIM_1_LAST_COUNT-=0x80000000;
 				mTIM_2_LAST_COUNT-=0x80000000;
@@ -1717,23 +2015,24 @@ void CMikie::Update(void)
 				mAUDIO_LAST_COUNT[2]-=0x80000000;
 				mAUDIO_LAST_COUNT[3]-=0x80000000;
 				startTS -= 0x80000000;
+				mSystem.mCpu->Break();
 				// Only correct if sleep is active
-				if(gSuzieDoneTime)
+				if(mState.SuzieDoneTime)
 				{
-					gSuzieDoneTime-=0x80000000;
+					mState.SuzieDoneTime-=0x80000000;
 				}
 			}
 
-			gNextTimerEvent=0xffffffff;
+			mState.NextTimerEvent=0xffffffff;
 
-			if(gSuzieDoneTime)
+			if(mState.SuzieDoneTime)
 			{
-				if(gSystemCycleCount >= gSuzieDoneTime)
+				if(mState.SystemCycleCount >= mState.SuzieDoneTime)
 				{
 					ClearCPUSleep();
-					gSuzieDoneTime = 0;
+					mState.SuzieDoneTime = 0;
 				}
-				else if(gSuzieDoneTime > gSystemCycleCount) gNextTimerEvent = gSuzieDoneTime;
+				else if(mState.SuzieDoneTime > mState.SystemCycleCount) mState.NextTimerEvent = mState.SuzieDoneTime;
 			}
 
 			//	Timer updates, rolled out flat in group order
@@ -1781,7 +2080,7 @@ void CMikie::Update(void)
 					// Ordinary clocked mode as opposed to linked mode
 					// 16MHz clock downto 1us == cyclecount >> 4 
 					divide=(4+mTIM_0_LINKING);
-					decval=(gSystemCycleCount-mTIM_0_LAST_COUNT)>>divide;
+					decval=(mState.SystemCycleCount-mTIM_0_LAST_COUNT)>>divide;
 
 					if(decval)
 					{
@@ -1837,9 +2136,9 @@ void CMikie::Update(void)
 					// then CURRENT may still be negative and we can use it to
 					// calc the next timer value, we just want another update ASAP
 					tmp=(mTIM_0_CURRENT&0x80000000)?1:((mTIM_0_CURRENT+1)<<divide);
-					tmp+=gSystemCycleCount;
-					if(tmp<gNextTimerEvent)
-						gNextTimerEvent=tmp;
+					tmp+=mState.SystemCycleCount;
+					if(tmp<mState.NextTimerEvent)
+						mState.NextTimerEvent=tmp;
 				}
 			}
 	
@@ -1869,7 +2168,7 @@ void CMikie::Update(void)
 //					// Ordinary clocked mode as opposed to linked mode
 //					// 16MHz clock downto 1us == cyclecount >> 4 
 //					divide=(4+mTIM_2_LINKING);
-//					decval=(gSystemCycleCount-mTIM_2_LAST_COUNT)>>divide;
+//					decval=(mState.SystemCycleCount-mTIM_2_LAST_COUNT)>>divide;
 //				}
 		
 				if(decval)
@@ -1916,8 +2215,8 @@ void CMikie::Update(void)
 // be beaten by the line timer on Timer 0
 //				if(mTIM_2_LINKING!=7)
 //				{
-//					tmp=gSystemCycleCount+((mTIM_2_CURRENT+1)<<divide);
-//					if(tmp<gNextTimerEvent)	gNextTimerEvent=tmp;
+//					tmp=mState.SystemCycleCount+((mTIM_2_CURRENT+1)<<divide);
+//					if(tmp<mState.NextTimerEvent)	mState.NextTimerEvent=tmp;
 //				}
 			}
 		
@@ -1948,7 +2247,7 @@ void CMikie::Update(void)
 					// 16MHz clock downto 1us == cyclecount >> 4 
 					// Additional /8 (+3) for 8 clocks per bit transmit
 					divide=4+3+mTIM_4_LINKING;
-					decval=(gSystemCycleCount-mTIM_4_LAST_COUNT)>>divide;
+					decval=(mState.SystemCycleCount-mTIM_4_LAST_COUNT)>>divide;
 				}
 		
 				if(decval)
@@ -2042,7 +2341,7 @@ void CMikie::Update(void)
 							if(mTIM_4_CURRENT&0x80000000)
 							{
 								mTIM_4_CURRENT=mTIM_4_BKUP;
-								mTIM_4_LAST_COUNT=gSystemCycleCount;
+								mTIM_4_LAST_COUNT=mState.SystemCycleCount;
 							}
 //						}
 //						else
@@ -2074,9 +2373,9 @@ void CMikie::Update(void)
 					// then CURRENT may still be negative and we can use it to
 					// calc the next timer value, we just want another update ASAP
 					tmp=(mTIM_4_CURRENT&0x80000000)?1:((mTIM_4_CURRENT+1)<<divide);
-					tmp+=gSystemCycleCount;
-					if(tmp<gNextTimerEvent)
-						gNextTimerEvent=tmp;
+					tmp+=mState.SystemCycleCount;
+					if(tmp<mState.NextTimerEvent)
+						mState.NextTimerEvent=tmp;
 //				}
 			}
 
@@ -2105,7 +2404,7 @@ void CMikie::Update(void)
 					// Ordinary clocked mode as opposed to linked mode
 					// 16MHz clock downto 1us == cyclecount >> 4 
 					divide=(4+mTIM_1_LINKING);
-					decval=(gSystemCycleCount-mTIM_1_LAST_COUNT)>>divide;
+					decval=(mState.SystemCycleCount-mTIM_1_LAST_COUNT)>>divide;
 		
 					if(decval)
 					{
@@ -2155,9 +2454,9 @@ void CMikie::Update(void)
 					// then CURRENT may still be negative and we can use it to
 					// calc the next timer value, we just want another update ASAP
 					tmp=(mTIM_1_CURRENT&0x80000000)?1:((mTIM_1_CURRENT+1)<<divide);
-					tmp+=gSystemCycleCount;
-					if(tmp<gNextTimerEvent)
-						gNextTimerEvent=tmp;
+					tmp+=mState.SystemCycleCount;
+					if(tmp<mState.NextTimerEvent)
+						mState.NextTimerEvent=tmp;
 				}
 			}
 		
@@ -2180,7 +2479,7 @@ void CMikie::Update(void)
 					// Ordinary clocked mode as opposed to linked mode
 					// 16MHz clock downto 1us == cyclecount >> 4 
 					divide=(4+mTIM_3_LINKING);
-					decval=(gSystemCycleCount-mTIM_3_LAST_COUNT)>>divide;
+					decval=(mState.SystemCycleCount-mTIM_3_LAST_COUNT)>>divide;
 				}
 		
 				if(decval)
@@ -2230,9 +2529,9 @@ void CMikie::Update(void)
 					// then CURRENT may still be negative and we can use it to
 					// calc the next timer value, we just want another update ASAP
 					tmp=(mTIM_3_CURRENT&0x80000000)?1:((mTIM_3_CURRENT+1)<<divide);
-					tmp+=gSystemCycleCount;
-					if(tmp<gNextTimerEvent)
-						gNextTimerEvent=tmp;
+					tmp+=mState.SystemCycleCount;
+					if(tmp<mState.NextTimerEvent)
+						mState.NextTimerEvent=tmp;
 				}
 			}
 		
@@ -2255,7 +2554,7 @@ void CMikie::Update(void)
 					// Ordinary clocked mode as opposed to linked mode
 					// 16MHz clock downto 1us == cyclecount >> 4 
 					divide=(4+mTIM_5_LINKING);
-					decval=(gSystemCycleCount-mTIM_5_LAST_COUNT)>>divide;
+					decval=(mState.SystemCycleCount-mTIM_5_LAST_COUNT)>>divide;
 				}
 		
 				if(decval)
@@ -2305,9 +2604,9 @@ void CMikie::Update(void)
 					// then CURRENT may still be negative and we can use it to
 					// calc the next timer value, we just want another update ASAP
 					tmp=(mTIM_5_CURRENT&0x80000000)?1:((mTIM_5_CURRENT+1)<<divide);
-					tmp+=gSystemCycleCount;
-					if(tmp<gNextTimerEvent)
-						gNextTimerEvent=tmp;
+					tmp+=mState.SystemCycleCount;
+					if(tmp<mState.NextTimerEvent)
+						mState.NextTimerEvent=tmp;
 				}
 			}
 		
@@ -2330,7 +2629,7 @@ void CMikie::Update(void)
 					// Ordinary clocked mode as opposed to linked mode
 					// 16MHz clock downto 1us == cyclecount >> 4 
 					divide=(4+mTIM_7_LINKING);
-					decval=(gSystemCycleCount-mTIM_7_LAST_COUNT)>>divide;
+					decval=(mState.SystemCycleCount-mTIM_7_LAST_COUNT)>>divide;
 				}
 		
 				if(decval)
@@ -2381,9 +2680,9 @@ void CMikie::Update(void)
 					// then CURRENT may still be negative and we can use it to
 					// calc the next timer value, we just want another update ASAP
 					tmp=(mTIM_7_CURRENT&0x80000000)?1:((mTIM_7_CURRENT+1)<<divide);
-					tmp+=gSystemCycleCount;
-					if(tmp<gNextTimerEvent)
-						gNextTimerEvent=tmp;
+					tmp+=mState.SystemCycleCount;
+					if(tmp<mState.NextTimerEvent)
+						mState.NextTimerEvent=tmp;
 				}
 			}
 		
@@ -2398,7 +2697,7 @@ void CMikie::Update(void)
 					// Ordinary clocked mode as opposed to linked mode
 					// 16MHz clock downto 1us == cyclecount >> 4 
 					divide=(4+mTIM_6_LINKING);
-					decval=(gSystemCycleCount-mTIM_6_LAST_COUNT)>>divide;
+					decval=(mState.SystemCycleCount-mTIM_6_LAST_COUNT)>>divide;
 		
 					if(decval)
 					{
@@ -2449,9 +2748,9 @@ void CMikie::Update(void)
 					// then CURRENT may still be negative and we can use it to
 					// calc the next timer value, we just want another update ASAP
 					tmp=(mTIM_6_CURRENT&0x80000000)?1:((mTIM_6_CURRENT+1)<<divide);
-					tmp+=gSystemCycleCount;
-					if(tmp<gNextTimerEvent)
-						gNextTimerEvent=tmp;
+					tmp+=mState.SystemCycleCount;
+					if(tmp<mState.NextTimerEvent)
+						mState.NextTimerEvent=tmp;
 				}
 			}
 
@@ -2483,7 +2782,7 @@ void CMikie::Update(void)
 						// Ordinary clocked mode as opposed to linked mode
 						// 16MHz clock downto 1us == cyclecount >> 4 
 						divide=(4+mAUDIO_LINKING[y]);
-						decval=(gSystemCycleCount-mAUDIO_LAST_COUNT[y])>>divide;
+						decval=(mState.SystemCycleCount-mAUDIO_LAST_COUNT[y])>>divide;
 					}
 
 					if(decval)
@@ -2526,7 +2825,7 @@ void CMikie::Update(void)
 							{
 								if(mAUDIO_WAVESHAPER[y]&0x0001) mAUDIO_OUTPUT[y]=mAUDIO_VOLUME[y]; else mAUDIO_OUTPUT[y]=-mAUDIO_VOLUME[y];
 							}
-							CombobulateSound(gSystemCycleCount - startTS);
+							CombobulateSound(mState.SystemCycleCount - startTS);
 						}
 						else
 						{
@@ -2551,25 +2850,27 @@ void CMikie::Update(void)
 						// then CURRENT may still be negative and we can use it to
 						// calc the next timer value, we just want another update ASAP
 						tmp=(mAUDIO_CURRENT[y]&0x80000000)?1:((mAUDIO_CURRENT[y]+1)<<divide);
-						tmp+=gSystemCycleCount;
-						if(tmp<gNextTimerEvent)
-							gNextTimerEvent=tmp;
+						tmp+=mState.SystemCycleCount;
+						if(tmp<mState.NextTimerEvent)
+							mState.NextTimerEvent=tmp;
 					}
 				}
 			 }
 			}
 
-			//	if(gSystemCycleCount==gNextTimerEvent) gError->Warning("CMikie::Update() - gSystemCycleCount==gNextTimerEvent, system lock likely");
+			//	if(mState.SystemCycleCount==mState.NextTimerEvent) gError->Warning("CMikie::Update() - mState.SystemCycleCount==mState.NextTimerEvent, system lock likely");
 
 			// Update system IRQ status as a result of timer activity
 			// OR is required to ensure serial IRQ's are not masked accidentally
 		
-			gSystemIRQ=(mTimerStatusFlags)?true:false;
-			if(gSystemIRQ && gSystemCPUSleep) { ClearCPUSleep(); /*puts("ARLARM"); */ }
-			//else if(gSuzieDoneTime) SetCPUSleep();
+			mState.SystemIRQ=(mTimerStatusFlags)?true:false;
+			if(mState.SystemIRQ && mState.SystemCPUSleep) { ClearCPUSleep(); /*puts("ARLARM"); */ }
+			//else if(mState.SuzieDoneTime) SetCPUSleep();
 
 			// Now all the timer updates are done we can increment the system
 			// counter for any work done within the Update() function, gSystemCycleCounter
 			// cannot be updated until this point otherwise it screws up the counters.
-			gSystemCycleCount+=mikie_work_done;
+			mState.SystemCycleCount+=mikie_work_done;
+
+			PERF_STOP(PERF_TIMERS);
 }
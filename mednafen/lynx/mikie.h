@@ -159,6 +159,15 @@ enum
 
 typedef Blip_Synth<blip_good_quality, 256 * 4> Synth;
 
+// Output palette in host pixels, the same split into one table per byte for
+// the SIMD line conversion, and the Lynx colours it was made from
+struct MikiePalette
+{
+	uint32	host[16];
+	uint8	planes[4][16];
+	uint16	lynx[16];	// Green in bits 0-3, red in 4-7, blue in 8-11
+};
+
 class CMikie : public CLynxBase
 {
 	public:
@@ -185,6 +194,8 @@ class CMikie : public CLynxBase
 		void	ComLynxTxCallback(void (*function)(int data,uint32 objref),uint32 objref);
 		
 		void	DisplaySetAttributes(int32 bpp);
+		void	DisplayConvertFrame(MDFN_Surface *surface);
+		bool	DisplayFrameChanged(void);
 		
 		void	BlowOut(void);
 
@@ -193,18 +204,33 @@ class CMikie : public CLynxBase
 
 		int StateAction(StateMem *sm, int load, int data_only);
 
-		inline void SetCPUSleep(void) {gSystemCPUSleep=true;};
-		inline void ClearCPUSleep(void) {gSystemCPUSleep=false;};
+		inline void SetCPUSleep(void) {mState.SystemCPUSleep=true;};
+		inline void ClearCPUSleep(void) {mState.SystemCPUSleep=false;};
 
 		void CombobulateSound(uint32 teatime);
 		void Update(void);
 
 		bool		mpSkipFrame;
+		bool		mpSkipSound;
+		bool		mpDisplayStale;		// Colour map not built for the current format yet
                 MDFN_Surface*   mpDisplayCurrent;
 		uint32		mpDisplayCurrentLine;
 
+		// Somewhat of a hack to make sure undrawn lines are black.
+		bool		mLineDrawn[256];
+
+		// The lines of the last frame as captured, valid while mLineDrawn[line]
+		const uint8*	GetLinePens(uint32 line) const { return mLinePens[line]; };
+		bool		GetLineFlip(uint32 line) const { return mLineFlip[line]; };
+		const uint16*	GetLinePalette(uint32 line) const { return mFramePalettes[mLinePalette[line]].lynx; };
+
 	private:
 		CSystem		&mSystem;
+		LynxState	&mState;
+
+		// Last output levels of CombobulateSound()
+		int			last_lsample;
+		int			last_rsample;
 
 		// Hardware storage
 		
@@ -216,6 +242,27 @@ class CMikie : public CLynxBase
 		TPALETTE	mPalette[16];
 		uint32		mColourMap[4096];
 
+		// mColourMap[mPalette[n].Index] for each pen n.  Kept up to date by the
+		// palette register writes, so drawing a line never needs mColourMap.
+		MikiePalette	mPaletteOut;
+		bool		mPaletteChanged;
+
+		// The lines of the current frame as the DMA read them, with the
+		// palettes they are shown in, see CaptureLine()
+		uint8		mLinePens[102][SCREEN_WIDTH/2];
+		uint8		mLineFlip[102];
+		uint8		mLinePalette[102];
+		MikiePalette	mFramePalettes[102];
+		uint32		mFramePaletteCount;
+
+		// Duplicate frame detection.  mPaletteSerial counts the changes of
+		// mPaletteOut, a line is unchanged if its pens, flip and serial are
+		// the same as in the last frame captured.
+		uint32		mPaletteSerial;
+		uint32		mLineSerial[102];
+		bool		mFrameChanged;
+		uint32		mLastFrameLines;
+
 		uint32		mIODAT;
 		uint32		mIODIR;
 		uint32		mIODAT_REST_SIGNAL;
@@ -378,7 +425,9 @@ class CMikie : public CLynxBase
 		uint32		mLynxLineDMACounter;
 		uint32		mLynxAddr;
 
-		void CopyLineSurface(int32 bpp);
+		void UpdatePen(uint32 pen);
+		void UpdatePaletteHost(void);
+		void CaptureLine(void);
 };
 
 
@@ -0,0 +1,73 @@
+//////////////////////////////////////////////////////////////////////////////
+// Host-time performance counters, see perf.h                               //
+//////////////////////////////////////////////////////////////////////////////
+
+#include "perf.h"
+
+#ifdef WANT_PERF_COUNTERS
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+extern struct retro_perf_callback perf_cb;
+
+PerfCounter gPerfCounters[PERF_COUNTERS] =
+{
+	{ { "lynx_frame" }, -1, 0, 0 },
+	{ { "lynx_cpu" }, -1, 0, 0 },
+	{ { "lynx_timers" }, -1, 0, 0 },
+	{ { "lynx_line_copy" }, -1, 0, 0 },
+	{ { "lynx_sprites" }, -1, 0, 0 },
+	{ { "lynx_audio" }, -1, 0, 0 },
+	{ { "lynx_state" }, -1, 0, 0 },
+};
+
+int gPerfActive=-1;
+
+static retro_perf_tick_t last_total[PERF_COUNTERS];
+static retro_perf_tick_t last_calls[PERF_COUNTERS];
+
+retro_perf_tick_t PerfTicksFallback(void)
+{
+	if(perf_cb.get_perf_counter)
+		return perf_cb.get_perf_counter();
+#ifdef _WIN32
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	return count.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (retro_perf_tick_t)ts.tv_sec*1000000000+ts.tv_nsec;
+#endif
+}
+
+void PerfRegister(const struct retro_perf_callback *cb)
+{
+	if(!cb->perf_register)
+		return;
+
+	for(int loop=0;loop<PERF_COUNTERS;loop++)
+	{
+		if(!gPerfCounters[loop].counter.registered)
+			cb->perf_register(&gPerfCounters[loop].counter);
+	}
+}
+
+void PerfEndFrame(void)
+{
+	for(int loop=0;loop<PERF_COUNTERS;loop++)
+	{
+		gPerfCounters[loop].frame_total=gPerfCounters[loop].counter.total-last_total[loop];
+		gPerfCounters[loop].frame_calls=gPerfCounters[loop].counter.call_cnt-last_calls[loop];
+		last_total[loop]=gPerfCounters[loop].counter.total;
+		last_calls[loop]=gPerfCounters[loop].counter.call_cnt;
+	}
+}
+
+#endif
+
+//END OF FILE
@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////////////////////
+// Host-time performance counters                                           //
+//////////////////////////////////////////////////////////////////////////////
+//                                                                          //
+// Compiled in only with WANT_PERF_COUNTERS (NEED_PERF_COUNTERS=1), the     //
+// PERF_START/PERF_STOP pairs are otherwise empty.  Counters nest and are   //
+// exclusive: while an inner counter runs (e.g. sprite painting triggered   //
+// by a CPU write) its time is not charged to the outer one.  The counters  //
+// are registered with the frontend's perf interface and are also          //
+// collected per frame for lynx_perf_get_frame_stats().                     //
+//                                                                          //
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef PERF_H
+#define PERF_H
+
+enum
+{
+	PERF_FRAME=0,		// Everything in retro_run() not covered below
+	PERF_CPU,			// C65C02 instruction dispatch
+	PERF_TIMERS,		// CMikie::Update timer evaluation
+	PERF_LINE,			// CMikie::CopyLineSurface
+	PERF_SPRITES,		// CSusie::PaintSprites
+	PERF_AUDIO,			// Blip_Buffer end_frame/read_samples
+	PERF_STATE,			// Savestate save/load
+	PERF_COUNTERS
+};
+
+#ifdef WANT_PERF_COUNTERS
+
+#include <libretro.h>
+#include "../mednafen-types.h"
+
+#if (defined(__GNUC__) || defined(_MSC_VER)) && (defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64))
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PERF_HAVE_RDTSC
+#endif
+
+struct PerfCounter
+{
+	struct retro_perf_counter	counter;
+	int							parent;
+	retro_perf_tick_t			frame_total;
+	retro_perf_tick_t			frame_calls;
+};
+
+extern PerfCounter	gPerfCounters[PERF_COUNTERS];
+extern int			gPerfActive;
+
+retro_perf_tick_t PerfTicksFallback(void);
+
+static INLINE retro_perf_tick_t PerfTicks(void)
+{
+#ifdef PERF_HAVE_RDTSC
+	return __rdtsc();
+#else
+	return PerfTicksFallback();
+#endif
+}
+
+static INLINE void PerfStart(int id)
+{
+	retro_perf_tick_t now=PerfTicks();
+
+	if(gPerfActive>=0)
+		gPerfCounters[gPerfActive].counter.total+=now-gPerfCounters[gPerfActive].counter.start;
+
+	gPerfCounters[id].parent=gPerfActive;
+	gPerfCounters[id].counter.start=now;
+	gPerfCounters[id].counter.call_cnt++;
+	gPerfActive=id;
+}
+
+static INLINE void PerfStop(int id)
+{
+	retro_perf_tick_t now=PerfTicks();
+
+	gPerfCounters[id].counter.total+=now-gPerfCounters[id].counter.start;
+	gPerfActive=gPerfCounters[id].parent;
+
+	if(gPerfActive>=0)
+		gPerfCounters[gPerfActive].counter.start=now;
+}
+
+void PerfRegister(const struct retro_perf_callback *cb);
+void PerfEndFrame(void);
+
+#define PERF_START(id)	PerfStart(id)
+#define PERF_STOP(id)	PerfStop(id)
+
+#else
+
+#define PERF_START(id)
+#define PERF_STOP(id)
+
+#endif
+
+#endif
@@ -47,9 +47,7 @@
 
 #include "system.h"
 #include "ram.h"
-#include "../mempatcher.h"
 #include "../mednafen-endian.h"
-#include <../md5.h>
 #include "../../scrc32.h"
 #include <algorithm>
 
@@ -65,13 +63,11 @@ bool CRam::TestMagic(const uint8* data, uint64 test_size)
 }
 
 CRam::CRam(MDFNFILE *fp)
-	:mRamXORData(NULL)
+	:mXORImage(NULL)
 {
 	if(fp)
 	{
 		uint8 raw_header[HEADER_RAW_SIZE];
-		md5_context md5;
-		md5.starts();
 		mCRC32 = 0;
 
 		file_read(fp, raw_header, sizeof(raw_header), 1);
@@ -82,8 +78,8 @@ CRam::CRam(MDFNFILE *fp)
 		 /* Lynx file format invalid (Magic No) */
 		}
 
-		mRamXORData = new uint8[RAM_SIZE];
-		memset(&mRamXORData[0], 0, RAM_SIZE);
+		mXORImage = LynxImage::Create(RAM_SIZE);
+		memset(&mXORImage->data[0], 0, RAM_SIZE);
 
 		const uint16   load_address = MDFN_de16msb(&raw_header[2]) - sizeof(raw_header);
 		const uint16   size = MDFN_de16msb(&raw_header[4]);
@@ -92,17 +88,15 @@ CRam::CRam(MDFNFILE *fp)
 
 		//printf("load_addr=%04x, size=%04x, rc0=%04x, rc1=%04x\n", load_address, size, rc0, rc1);
 
-		file_read(fp, &mRamXORData[load_address], rc0, 1);
-		md5.update(&mRamXORData[load_address], rc0);
-		mCRC32 = crc32(mCRC32, &mRamXORData[load_address], rc0);
-		file_read(fp, &mRamXORData[0x0000], rc1, 1);
-		md5.update(&mRamXORData[0x0000], rc1);
-		mCRC32 = crc32(mCRC32, &mRamXORData[0x0000], rc1);
+		file_read(fp, &mXORImage->data[load_address], rc0, 1);
+		mCRC32 = crc32(mCRC32, &mXORImage->data[load_address], rc0);
+		file_read(fp, &mXORImage->data[0x0000], rc1, 1);
+		mCRC32 = crc32(mCRC32, &mXORImage->data[0x0000], rc1);
 
 		InfoRAMSize = size;
 
 		for(unsigned i = 0; i < RAM_SIZE; i++)
-		 mRamXORData[i] ^= DEFAULT_RAM_CONTENTS;
+		 mXORImage->data[i] ^= DEFAULT_RAM_CONTENTS;
 
 		boot_addr = load_address;
 	}
@@ -113,26 +107,34 @@ CRam::CRam(MDFNFILE *fp)
 	Reset();
 }
 
+// Share the homebrew image of another CRam
+CRam::CRam(const CRam &ram,LynxShare)
+	:InfoRAMSize(ram.InfoRAMSize),
+	mXORImage(ram.mXORImage ? ram.mXORImage->Ref() : NULL),
+	boot_addr(ram.boot_addr),
+	mCRC32(ram.mCRC32)
+{
+	Reset();
+}
+
 CRam::~CRam()
 {
-	if (mRamXORData != NULL)
-		delete[] mRamXORData;
+	if (mXORImage != NULL)
+		mXORImage->Release();
 }
 
 void CRam::Reset(void)
 {
-	MDFNMP_AddRAM(65536, 0x0000, mRamData);
-
 	for(unsigned i = 0; i < RAM_SIZE; i++)
 	 mRamData[i] = DEFAULT_RAM_CONTENTS;
 
-	if(mRamXORData)
+	if(mXORImage)
 	{
 	 for(unsigned i = 0; i < RAM_SIZE; i++)
-	  mRamData[i] ^= mRamXORData[i];
-
-	 gCPUBootAddress = boot_addr;
+	  mRamData[i] ^= mXORImage->data[i];
 	}
+
+	MarkAllDirty();
 }
 
 //END OF FILE
@@ -49,6 +49,17 @@
 #define RAM_ADDR_MASK			0xffff
 #define DEFAULT_RAM_CONTENTS	0xff
 
+// Dirty page tracking, compiled in with WANT_DIRTY_PAGES (NEED_DIRTY_PAGES=1).
+// Every write to RAM from the CPU, Suzy or the memory map flags its 256
+// byte page until the flags are cleared.
+#define RAM_PAGES				(RAM_SIZE>>8)
+
+#ifdef WANT_DIRTY_PAGES
+#define RAM_MARK_DIRTY(pages,addr)	((pages)[((uint16)(addr))>>8]=1)
+#else
+#define RAM_MARK_DIRTY(pages,addr)
+#endif
+
 class CRam : public CLynxBase
 {
 
@@ -58,6 +69,7 @@ class CRam : public CLynxBase
 		enum { HEADER_RAW_SIZE = 10 };
 
 		CRam(MDFNFILE *fp) MDFN_COLD;
+		CRam(const CRam &ram,LynxShare) MDFN_COLD;
 		~CRam() MDFN_COLD;
 		static bool TestMagic(const uint8* data, uint64 test_size) MDFN_COLD;
 
@@ -65,23 +77,31 @@ class CRam : public CLynxBase
 
 		void	Reset(void) MDFN_COLD;
 
-		void	Poke(uint32 addr, uint8 data){ mRamData[(uint16)addr]=data;};
+		void	Poke(uint32 addr, uint8 data){ mRamData[(uint16)addr]=data; RAM_MARK_DIRTY(mDirtyPages,addr);};
 		uint8	Peek(uint32 addr){ return(mRamData[(uint16)addr]);};
 		uint32	ReadCycle(void) {return 5;};
 		uint32	WriteCycle(void) {return 5;};
 		uint32   ObjectSize(void) {return RAM_SIZE;};
 		uint8*	GetRamPointer(void) { return mRamData; };
 		uint32	CRC32(void) { return mCRC32; };
+		uint32	GetBootAddress(void) { return mXORImage ? boot_addr : 0; };
+		uint8*	GetDirtyPages(void) { return mDirtyPages; };
+		void	MarkAllDirty(void) { memset(mDirtyPages, 1, RAM_PAGES); };
 
 		uint32	InfoRAMSize;
 	// Data members
 
 	private:
 		uint8	mRamData[RAM_SIZE];
-		uint8	*mRamXORData;
+		uint8	mDirtyPages[RAM_PAGES];
+		LynxImage	*mXORImage;	// Homebrew image, shared by the machines running it
 		uint16	boot_addr;
 		uint32	mCRC32;
 
+		// noncopyable
+		CRam(const CRam &ram);
+		CRam& operator=(const CRam &ram);
+
 };
 
 #endif
@@ -52,10 +52,11 @@
 CRom::CRom(const char *romfile)
 {
 	mWriteEnable=false;
+	mImage=LynxImage::Create(ROM_SIZE);
 	Reset();
 
 	// Initialise ROM
-	for(int loop=0;loop<ROM_SIZE;loop++) mRomData[loop]=DEFAULT_ROM_CONTENTS;
+	for(int loop=0;loop<ROM_SIZE;loop++) mImage->data[loop]=DEFAULT_ROM_CONTENTS;
 
    // Load up the file
 
@@ -71,16 +72,31 @@ CRom::CRom(const char *romfile)
     if(BIOSFile->size < 512)
     {
       /* Lynx Boot ROM image is of an incorrect size. */
+       file_close(BIOSFile);
        return;
     }
 
 //    memcpy(mRomData, BIOSFile->data, 512);
-    file_read(BIOSFile, mRomData, 512, 1);
+    file_read(BIOSFile, mImage->data, 512, 1);
 
     file_close(BIOSFile);
    }
 }
 
+// Share the BIOS image of another CRom.  Nothing enables ROM writes, so the
+// image stays read-only.
+CRom::CRom(const CRom &rom,LynxShare)
+{
+	mWriteEnable=false;
+	mImage=rom.mImage->Ref();
+	Reset();
+}
+
+CRom::~CRom()
+{
+	mImage->Release();
+}
+
 void CRom::Reset(void)
 {
 	// Nothing to do here
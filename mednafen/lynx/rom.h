@@ -61,21 +61,28 @@ class CRom : public CLynxBase
 
 	public:
 		CRom(const char *) MDFN_COLD;
+		CRom(const CRom &rom,LynxShare) MDFN_COLD;
+		~CRom() MDFN_COLD;
 
 	public:
 		void	Reset(void) MDFN_COLD;
-		void	Poke(uint32 addr,uint8 data) { if(mWriteEnable) mRomData[addr&ROM_ADDR_MASK]=data;};
-		uint8	Peek(uint32 addr) { return(mRomData[addr&ROM_ADDR_MASK]);};
+		void	Poke(uint32 addr,uint8 data) { if(mWriteEnable) mImage->data[addr&ROM_ADDR_MASK]=data;};
+		uint8	Peek(uint32 addr) { return(mImage->data[addr&ROM_ADDR_MASK]);};
 		uint32	ReadCycle(void) {return 5;};
 		uint32	WriteCycle(void) {return 5;};
 		uint32	ObjectSize(void) {return ROM_SIZE;};
+		uint8*	GetRomPointer(void) {return mImage->data;};
 
 	// Data members
 
 	public:
 		bool	mWriteEnable;
 	private:
-		uint8	mRomData[ROM_SIZE];
+		LynxImage	*mImage;	// The BIOS, shared by the machines running a game
+
+		// noncopyable
+		CRom(const CRom &rom);
+		CRom& operator=(const CRom &rom);
 };
 
 #endif
@@ -57,13 +57,14 @@
 //
 #define RAM_PEEK(m)				(mRamPointer[(uint16)(m)])
 #define RAM_PEEKW(m)			(mRamPointer[(uint16)(m)]+(mRamPointer[(uint16)((m)+1)]<<8))
-#define RAM_POKE(m1,m2)			{mRamPointer[(uint16)(m1)]=(m2);}
+#define RAM_POKE(m1,m2)			{mRamPointer[(uint16)(m1)]=(m2); RAM_MARK_DIRTY(mDirtyPages,m1);}
 
-uint32 cycles_used=0;
 
 CSusie::CSusie(CSystem& parent)
-	:mSystem(parent)
+	:mSystem(parent),
+	mState(parent.mState)
 {
+	cycles_used=0;
 	Reset();
 }
 
@@ -77,6 +78,7 @@ void CSusie::Reset(void)
 	// and seeing as Susie only ever sees RAM.
 
 	mRamPointer=mSystem.GetRamPointer();
+	mDirtyPages=mSystem.GetDirtyPages();
 
 	// Reset ALL variables
 
@@ -716,7 +718,7 @@ uint32 CSusie::PaintSprites(void)
 		if(sprcount>4096)
 		{
 			// Stop the system, otherwise we may just come straight back in.....
-			gSystemHalt=true;
+			mState.SystemHalt=true;
 			// Display warning message
 			//gError->Warning("CSusie:PaintSprites(): Single draw sprite limit exceeded (>4096). The SCB is most likely looped back on itself. Reset/Exit is recommended");
 			// Signal error to the caller
@@ -1804,7 +1806,7 @@ uint8 CSusie::Peek(uint32 addr)
 		case (SPRSYS&0xff):
 			retval=0x0000;
 			//	retval+=(mSPRSYS_Status)?0x0001:0x0000;
-			retval+= (gSuzieDoneTime)?0x0001:0x0000;
+			retval+= (mState.SuzieDoneTime)?0x0001:0x0000;
 			retval+=(mSPRSYS_StopOnCurrent)?0x0002:0x0000;
 			retval+=(mSPRSYS_UnsafeAccess)?0x0004:0x0000;
 			retval+=(mSPRSYS_LeftHand)?0x0008:0x0000;
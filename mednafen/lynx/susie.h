@@ -329,6 +329,9 @@ class CSusie : public CLynxBase
 
 	private:
 		CSystem&	mSystem;
+		LynxState&	mState;
+
+		uint32		cycles_used;	// Bus cycles of the current PaintSprites()
 
 		Uuint16		mTMPADR;		// ENG
 		Uuint16		mTILTACUM;		// ENG
@@ -413,6 +416,7 @@ class CSusie : public CLynxBase
 		int			mCollision;
 
 		uint8		*mRamPointer;
+		uint8		*mDirtyPages;
 
 		uint32		mLineBaseAddress;
 		uint32		mLineCollisionAddress;
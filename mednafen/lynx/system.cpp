@@ -31,9 +31,9 @@
 // This class provides the glue to bind of of the emulation objects         //
 // together via peek/poke handlers and pass thru interfaces to lower        //
 // objects, all control of the emulator is done via this class. Update()    //
-// does most of the work and each call emulates one CPU instruction and     //
-// updates all of the relevant hardware if required. It must be remembered  //
-// that if that instruction involves setting SPRGO then, it will cause a    //
+// does most of the work, each call updates the timers if one is due and    //
+// then runs the CPU up to the next timer event. It must be remembered      //
+// that if an instruction involves setting SPRGO then, it will cause a      //
 // sprite painting operation and then a corresponding update of all of the  //
 // hardware which will usually involve recursive calls to Update, see       //
 // Mikey SPRGO code for more details.                                       //
@@ -49,8 +49,6 @@
 //                                                                          //
 //////////////////////////////////////////////////////////////////////////////
 
-#define SYSTEM_CPP
-
 #include "mednafen/lynx/system.h"
 #include "mednafen/mednafen-endian.h"
 
@@ -68,6 +66,7 @@ CSystem::CSystem(MDFNFILE *fp, const char *bios_path)
 	mSusie(NULL)
 {
 	mFileType=HANDY_FILETYPE_ILLEGAL;
+	memset(&mState, 0, sizeof(mState));
 
 	char clip[11];
    file_read(fp, clip, 11, 1);
@@ -88,8 +87,6 @@ CSystem::CSystem(MDFNFILE *fp, const char *bios_path)
        * just load the core into an "Insert Game" screen */
 	}
 
-	MDFNMP_Init(65536, 1);
-
 	// Create the system objects that we'll use
 
 	// Attempt to load the cartridge errors caught above here...
@@ -117,6 +114,32 @@ CSystem::CSystem(MDFNFILE *fp, const char *bios_path)
 			break;
 	}
 
+	CreateHardware();
+}
+
+// Create a powered up machine running the same game and BIOS as 'image',
+// sharing their images.  The cart is copied with anything written to it.
+CSystem::CSystem(const CSystem &image,LynxShare)
+	:mCart(NULL),
+	mRom(NULL),
+	mMemMap(NULL),
+	mRam(NULL),
+	mCpu(NULL),
+	mMikie(NULL),
+	mSusie(NULL)
+{
+	mFileType=image.mFileType;
+	memset(&mState, 0, sizeof(mState));
+
+	mRom = new CRom(*image.mRom,SHARE_IMAGE);
+	mCart = new CCart(*image.mCart);
+	mRam = new CRam(*image.mRam,SHARE_IMAGE);
+
+	CreateHardware();
+}
+
+void CSystem::CreateHardware(void)
+{
 	// These can generate exceptions
 
 	mMikie = new CMikie(*this);
@@ -128,7 +151,7 @@ CSystem::CSystem(MDFNFILE *fp, const char *bios_path)
 
 // Now the handlers are set we can instantiate the CPU as is will use handlers on reset
 
-	mCpu = new C65C02(*this);
+	mCpu = new C65C02(*this, mState);
 
 // Now init is complete do a reset, this will cause many things to be reset twice
 // but what the hell, who cares, I don't.....
@@ -151,15 +174,15 @@ CSystem::~CSystem()
 
 void CSystem::Reset(void)
 {
-	mMikie->startTS -= gSystemCycleCount;
-	gSystemCycleCount=0;
-	gNextTimerEvent=0;
-	gCPUBootAddress=0;
-	gSystemIRQ=false;
-	gSystemNMI=false;
-	gSystemCPUSleep=false;
-	gSystemHalt=false;
-	gSuzieDoneTime = 0;
+	mMikie->startTS -= mState.SystemCycleCount;
+	mState.SystemCycleCount=0;
+	mState.NextTimerEvent=0;
+	mState.CPUBootAddress=mRam->GetBootAddress();
+	mState.SystemIRQ=false;
+	mState.SystemNMI=false;
+	mState.SystemCPUSleep=false;
+	mState.SystemHalt=false;
+	mState.SuzieDoneTime = 0;
 
 	mMemMap->Reset();
 	mCart->Reset();
@@ -177,14 +200,11 @@ void CSystem::Reset(void)
 
 		C6502_REGS regs;
 		mCpu->GetRegs(regs);
-		regs.PC=(uint16)gCPUBootAddress;
+		regs.PC=(uint16)mState.CPUBootAddress;
 		mCpu->SetRegs(regs);
 	}
 }
 
-// Somewhat of a hack to make sure undrawn lines are black.
-bool LynxLineDrawn[256];
-
 CSystem *lynxie = NULL;
 
 static bool TestMagic(const char *name, MDFNFILE *fp)
@@ -216,6 +236,9 @@ void Load(MDFNFILE *fp, const char *bios_path)
 {
  lynxie = new CSystem(fp, bios_path);
 
+ MDFNMP_Init(65536, 1);
+ MDFNMP_AddRAM(65536, 0x0000, lynxie->GetRamPointer());
+
  switch(lynxie->CartGetRotate())
  {
   case CART_ROTATE_LEFT:
@@ -244,45 +267,56 @@ void CloseGame(void)
  Cleanup();
 }
 
-static uint8 *chee;
-void Emulate(EmulateSpecStruct *espec)
+void CSystem::Emulate(EmulateSpecStruct *espec)
 {
  espec->DisplayRect.x = 0;
  espec->DisplayRect.y = 0;
  espec->DisplayRect.w = 160;
  espec->DisplayRect.h = 102;
 
+ // Frames that aren't shown don't need the colour map, it is rebuilt by the
+ // next one that is
  if(espec->VideoFormatChanged)
-  lynxie->DisplaySetAttributes(espec->surface->bpp);
+  mMikie->mpDisplayStale = true;
 
- if(espec->SoundFormatChanged)
+ if(mMikie->mpDisplayStale && !espec->skip)
  {
-  lynxie->mMikie->mikbuf.set_sample_rate(espec->SoundRate ? espec->SoundRate : 44100, 60);
-  lynxie->mMikie->mikbuf.clock_rate((long int)(16000000 / 4));
-  lynxie->mMikie->mikbuf.bass_freq(60);
-  lynxie->mMikie->miksynth.volume(0.50);
+  DisplaySetAttributes(espec->surface->bpp);
+  mMikie->mpDisplayStale = false;
  }
 
- uint16 butt_data = chee[0] | (chee[1] << 8);
+ if(espec->SoundFormatChanged)
+ {
+  mMikie->mikbuf.set_sample_rate(espec->SoundRate ? espec->SoundRate : 44100, 60);
+  mMikie->mikbuf.clock_rate((long int)(16000000 / 4));
+  mMikie->mikbuf.bass_freq(60);
+  mMikie->miksynth.volume(0.50);
+ }
 
- lynxie->SetButtonData(butt_data);
+ // A skipped frame captures no lines, keep those of the last frame drawn
+ if(!espec->skip)
+  memset(mMikie->mLineDrawn, 0, sizeof(mMikie->mLineDrawn[0]) * 102);
 
- MDFNMP_ApplyPeriodicCheats();
+ mMikie->mpSkipFrame = espec->skip;
+ mMikie->mpSkipSound = !espec->SoundBuf;
+ mMikie->mpDisplayCurrent = espec->surface;
+ mMikie->mpDisplayCurrentLine = 0;
+ mMikie->startTS = mState.SystemCycleCount;
 
- memset(LynxLineDrawn, 0, sizeof(LynxLineDrawn[0]) * 102);
+ RunUntil(700000);
 
- lynxie->mMikie->mpSkipFrame = espec->skip;
- lynxie->mMikie->mpDisplayCurrent = espec->surface;
- lynxie->mMikie->mpDisplayCurrentLine = 0;
- lynxie->mMikie->startTS = gSystemCycleCount;
+ // The comparison with the frame before has to be kept up to date even when
+ // the driver can't use it
+ espec->VideoUnchanged = false;
+ if(!espec->skip && !mMikie->DisplayFrameChanged() && espec->CanDupe)
+  espec->VideoUnchanged = true;
 
- while(lynxie->mMikie->mpDisplayCurrent && (gSystemCycleCount - lynxie->mMikie->startTS) < 700000)
+ if(!espec->skip && !espec->raw_video && !espec->VideoUnchanged)
  {
-  lynxie->Update();
-//  printf("%d ", gSystemCycleCount - lynxie->mMikie->startTS);
- }
+	 PERF_START(PERF_LINE);
+	 mMikie->DisplayConvertFrame(espec->surface);
+	 PERF_STOP(PERF_LINE);
 
- {
 	 // FIXME, we should integrate this into mikie.*
 	 uint32 color_black;
 	 if (espec->surface->bpp == 16)
@@ -296,7 +330,7 @@ void Emulate(EmulateSpecStruct *espec)
 		 {
 			 uint16 *row = espec->surface->pixels + y * espec->surface->pitch;
 
-			 if (!LynxLineDrawn[y])
+			 if (!mMikie->mLineDrawn[y])
 			 {
 				 for (int x = 0; x < 160; x++)
 					 row[x] = color_black;
@@ -310,7 +344,7 @@ void Emulate(EmulateSpecStruct *espec)
 		 {
 			 uint32 *row = (uint32*)espec->surface->pixels + y * espec->surface->pitch;
 
-			 if (!LynxLineDrawn[y])
+			 if (!mMikie->mLineDrawn[y])
 			 {
 				 for (int x = 0; x < 160; x++)
 					 row[x] = color_black;
@@ -319,15 +353,32 @@ void Emulate(EmulateSpecStruct *espec)
 	 }
  }
 
- espec->MasterCycles = gSystemCycleCount - lynxie->mMikie->startTS;
+ espec->MasterCycles = mState.SystemCycleCount - mMikie->startTS;
 
+ // Nothing was mixed into the buffer if the sound isn't wanted.  Leaving the
+ // frame open keeps whatever the last mixed frame left in it, so the next one
+ // carries on from there as if this frame never happened.
+ PERF_START(PERF_AUDIO);
  if(espec->SoundBuf)
  {
-  lynxie->mMikie->mikbuf.end_frame((gSystemCycleCount - lynxie->mMikie->startTS) >> 2);
-  espec->SoundBufSize = lynxie->mMikie->mikbuf.read_samples(espec->SoundBuf, espec->SoundBufMaxSize) / 2; // divide by nr audio chn
+  mMikie->mikbuf.end_frame((mState.SystemCycleCount - mMikie->startTS) >> 2);
+  espec->SoundBufSize = mMikie->mikbuf.read_samples(espec->SoundBuf, espec->SoundBufMaxSize) / 2; // divide by nr audio chn
  }
  else
   espec->SoundBufSize = 0;
+ PERF_STOP(PERF_AUDIO);
+}
+
+static uint8 *chee;
+void Emulate(EmulateSpecStruct *espec)
+{
+ uint16 butt_data = chee[0] | (chee[1] << 8);
+
+ lynxie->SetButtonData(butt_data);
+
+ MDFNMP_ApplyPeriodicCheats();
+
+ lynxie->Emulate(espec);
 }
 
 void SetInput(unsigned port, const char *type, uint8 *ptr)
@@ -353,31 +404,40 @@ static void TransformInput(void)
  }
 }
 
-int StateAction(StateMem *sm, int load, int data_only)
+int CSystem::StateAction(StateMem *sm, int load, int data_only)
 {
  SFORMAT SystemRegs[] =
  {
-	SFVAR(gSuzieDoneTime),
-        SFVAR(gSystemCycleCount),
-        SFVAR(gNextTimerEvent),
-        SFVAR(gCPUBootAddress),
-        SFVAR(gSystemIRQ),
-        SFVAR(gSystemNMI),
-        SFVAR(gSystemCPUSleep),
-        SFVAR(gSystemHalt),
-	SFARRAYN(lynxie->GetRamPointer(), RAM_SIZE, "RAM"),
+	SFVARN(mState.SuzieDoneTime, "gSuzieDoneTime"),
+        SFVARN(mState.SystemCycleCount, "gSystemCycleCount"),
+        SFVARN(mState.NextTimerEvent, "gNextTimerEvent"),
+        SFVARN(mState.CPUBootAddress, "gCPUBootAddress"),
+        SFVARN(mState.SystemIRQ, "gSystemIRQ"),
+        SFVARN(mState.SystemNMI, "gSystemNMI"),
+        SFVARN(mState.SystemCPUSleep, "gSystemCPUSleep"),
+        SFVARN(mState.SystemHalt, "gSystemHalt"),
+	SFARRAYN(GetRamPointer(), RAM_SIZE, "RAM"),
 	SFEND
  };
 
+ PERF_START(PERF_STATE);
  int ret = MDFNSS_StateAction(sm, load, data_only, SystemRegs, "SYST", false);
- ret &= lynxie->mSusie->StateAction(sm, load, data_only);
- ret &= lynxie->mMemMap->StateAction(sm, load, data_only);
- ret &= lynxie->mCart->StateAction(sm, load, data_only);
- ret &= lynxie->mMikie->StateAction(sm, load, data_only);
- ret &= lynxie->mCpu->StateAction(sm, load, data_only);
+ ret &= mSusie->StateAction(sm, load, data_only);
+ ret &= mMemMap->StateAction(sm, load, data_only);
+ ret &= mCart->StateAction(sm, load, data_only);
+ ret &= mMikie->StateAction(sm, load, data_only);
+ ret &= mCpu->StateAction(sm, load, data_only);
+ if(load)
+  mRam->MarkAllDirty();
+ PERF_STOP(PERF_STATE);
  return ret;
 }
 
+int StateAction(StateMem *sm, int load, int data_only)
+{
+ return lynxie->StateAction(sm, load, data_only);
+}
+
 static void SetLayerEnableMask(uint64 mask)
 {
 
@@ -62,28 +62,23 @@
 #define HANDY_SCREEN_WIDTH	160
 #define HANDY_SCREEN_HEIGHT	102
 //
-// Define the global variable list
+// CPU/timer state of one machine.  It is owned by the CSystem and every part
+// of the system works through a reference to it, so independent machines can
+// run side by side.  It is all read on every instruction or timer update and
+// kept in a single cache line.
 //
 
-#ifdef SYSTEM_CPP
-	uint32   gSuzieDoneTime = 0;
-	uint32	gSystemCycleCount=0;
-	uint32	gNextTimerEvent=0;
-	uint32	gCPUBootAddress=0;
-	uint32	gSystemIRQ=false;
-	uint32	gSystemNMI=false;
-	uint32	gSystemCPUSleep=false;
-	uint32	gSystemHalt=false;
-#else
-	extern uint32	gSystemCycleCount;
-	extern uint32	gSuzieDoneTime;
-	extern uint32	gNextTimerEvent;
-	extern uint32	gCPUBootAddress;
-	extern uint32	gSystemIRQ;
-	extern uint32	gSystemNMI;
-	extern uint32	gSystemCPUSleep;
-	extern uint32	gSystemHalt;
-#endif
+struct MDFN_ALIGN(64) LynxState
+{
+	uint32	SystemCycleCount;
+	uint32	NextTimerEvent;
+	uint32	SuzieDoneTime;
+	uint32	SystemIRQ;
+	uint32	SystemCPUSleep;
+	uint32	SystemNMI;
+	uint32	SystemHalt;
+	uint32	CPUBootAddress;
+};
 
 //
 // Define the interfaces before we start pulling in the classes
@@ -105,41 +100,86 @@ class CSystem;
 #include "susie.h"
 #include "mikie.h"
 #include "c65c02.h"
+#include "perf.h"
 
 #define TOP_START	0xfc00
 #define TOP_MASK	0x03ff
 #define TOP_SIZE	0x400
 #define SYSTEM_SIZE	65536
 
+//
+// CPU view of $FC00-$FFFF, the only addresses the memory map at $FFF9 can
+// change.  One entry for each 256 byte page, except that the last 8 bytes
+// ($FFF8-$FFFF) get an entry each for the memory map register and the
+// vectors.  Plain RAM and ROM are read and written through the pointers,
+// with the page offset of the address, anything else goes to the handler.
+//
+
+#define TOP_PAGES		4
+#define TOP_FIXED_START	0xfff8
+#define TOP_ENTRIES		(TOP_PAGES+8)
+
+enum
+{
+	TOP_IO_RAM,
+	TOP_IO_SUSIE,
+	TOP_IO_MIKIE,
+	TOP_IO_ROM,
+	TOP_IO_MEMMAP
+};
+
+struct LynxTopPage
+{
+	uint8	*read;		// NULL to read through the handler
+	uint8	*write;		// NULL to write through the handler
+	uint32	handler;	// TOP_IO_*
+};
+
 class CSystem : public CSystemBase
 {
 	public:
 		CSystem(MDFNFILE *fp, const char *bios_path) MDFN_COLD;
+		CSystem(const CSystem &image,LynxShare) MDFN_COLD;
 		~CSystem() MDFN_COLD;
 
 	public:
 		void	Reset(void) MDFN_COLD;
 
-		inline void Update(void)
+		inline void Update(uint32 frame_cycles)
 		{
 			// 
 			// Only update if there is a predicted timer event
 			//
-			if(gSystemCycleCount>=gNextTimerEvent)
+			if(mState.SystemCycleCount>=mState.NextTimerEvent)
 			{
 				mMikie->Update();
 			}
 			//
-			// Step the processor through 1 instruction
+			// Run the processor up to the next timer event or the frame cycle
+			// limit, just one instruction if the timer update ended the frame
 			//
-			mCpu->Update();
+			PERF_START(PERF_CPU);
+			mCpu->Run(mMikie->mpDisplayCurrent ? mMikie->startTS+frame_cycles : 0);
+			PERF_STOP(PERF_CPU);
 
 			//
 			// If the CPU is asleep then skip to the next timer event
 			//			
-			if(gSystemCPUSleep)
+			if(mState.SystemCPUSleep)
 			{
-				gSystemCycleCount=gNextTimerEvent;
+				mState.SystemCycleCount=mState.NextTimerEvent;
+			}
+		}
+
+		//
+		// Run the system until the frame ends or 'cycle' cycles have passed
+		// since the frame started
+		//
+		inline void RunUntil(uint32 cycle)
+		{
+			while(mMikie->mpDisplayCurrent && (mState.SystemCycleCount-mMikie->startTS)<cycle)
+			{
+				Update(cycle);
 			}
 		}
 
@@ -156,10 +196,45 @@ class CSystem : public CSystemBase
 		//
 		// CPU
 		//
-		inline void  Poke_CPU(uint32 addr, uint8 data) { mMemoryHandlers[addr]->Poke(addr,data);};
-		inline uint8 Peek_CPU(uint32 addr) { return mMemoryHandlers[addr]->Peek(addr);};
-		inline void  PokeW_CPU(uint32 addr,uint16 data) { mMemoryHandlers[addr]->Poke(addr,data&0xff);addr++;mMemoryHandlers[addr]->Poke(addr,data>>8);};
-		inline uint16 PeekW_CPU(uint32 addr) {return ((mMemoryHandlers[addr]->Peek(addr))+(mMemoryHandlers[addr]->Peek(addr+1)<<8));};
+		// Only for addresses from TOP_START up, the CPU reads and writes
+		// the RAM below that directly
+		inline LynxTopPage& TopPage(uint32 addr) { return mTopPages[(addr>=TOP_FIXED_START)?TOP_PAGES+(addr&7):(addr>>8)&(TOP_PAGES-1)];};
+
+		// The handlers are called by their class rather than through
+		// CLynxBase, so the calls are direct
+		inline void  Poke_CPU(uint32 addr, uint8 data)
+		{
+			LynxTopPage &page=TopPage(addr);
+			if(page.write)
+			{
+				page.write[addr&0xff]=data;
+				RAM_MARK_DIRTY(mRam->GetDirtyPages(),addr);
+				return;
+			}
+			switch(page.handler)
+			{
+				case TOP_IO_SUSIE: mSusie->CSusie::Poke(addr,data); break;
+				case TOP_IO_MIKIE: mMikie->CMikie::Poke(addr,data); break;
+				case TOP_IO_ROM: mRom->CRom::Poke(addr,data); break;
+				case TOP_IO_MEMMAP: mMemMap->CMemMap::Poke(addr,data); break;
+				default: mRam->CRam::Poke(addr,data); break;
+			}
+		};
+		inline uint8 Peek_CPU(uint32 addr)
+		{
+			LynxTopPage &page=TopPage(addr);
+			if(page.read) return page.read[addr&0xff];
+			switch(page.handler)
+			{
+				case TOP_IO_SUSIE: return mSusie->CSusie::Peek(addr);
+				case TOP_IO_MIKIE: return mMikie->CMikie::Peek(addr);
+				case TOP_IO_ROM: return mRom->CRom::Peek(addr);
+				case TOP_IO_MEMMAP: return mMemMap->CMemMap::Peek(addr);
+				default: return mRam->CRam::Peek(addr);
+			}
+		};
+		inline void  PokeW_CPU(uint32 addr,uint16 data) { Poke_CPU(addr,data&0xff);Poke_CPU(addr+1,data>>8);};
+		inline uint16 PeekW_CPU(uint32 addr) {return Peek_CPU(addr)+(Peek_CPU(addr+1)<<8);};
 
 // High level cart access for debug etc
 
@@ -203,10 +278,15 @@ class CSystem : public CSystemBase
 		uint32	GetButtonData(void) {return mSusie->GetButtonData();};
 		void	SetCycleBreakpoint(uint32 breakpoint) {mCycleCountBreakpoint=breakpoint;};
 		uint8*	GetRamPointer(void) {return mRam->GetRamPointer();};
+		uint8*	GetDirtyPages(void) {return mRam->GetDirtyPages();};
+
+		void	Emulate(EmulateSpecStruct *espec);
+		int		StateAction(StateMem *sm, int load, int data_only) MDFN_COLD;
 
 	public:
+		LynxState		mState;
 		uint32			mCycleCountBreakpoint;
-		CLynxBase		*mMemoryHandlers[SYSTEM_SIZE];
+		LynxTopPage		mTopPages[TOP_ENTRIES];
 		CCart			*mCart;
 		CRom			*mRom;
 		CMemMap			*mMemMap;
@@ -216,9 +296,14 @@ class CSystem : public CSystemBase
 		CSusie			*mSusie;
 
 		uint32			mFileType;
-};
 
-extern bool LynxLineDrawn[256];
+	private:
+		void	CreateHardware(void) MDFN_COLD;
+
+		// noncopyable
+		CSystem(const CSystem &image);
+		CSystem& operator=(const CSystem &image);
+};
 
 void Load(MDFNFILE *fp, const char *bios_path);
 void CloseGame(void);
@@ -30,6 +30,14 @@
 
 #define RLSB 		MDFNSTATE_RLSB	//0x80000000
 
+// Compact states, see StateMem::compact.  Each section starts with a hash of
+// the names and sizes of its fields, a state written with a different
+// SFORMAT table is rejected instead of being read at the wrong offsets.
+// Only meant for states the same build loads again, such as those of
+// rewind or rollback, the named format is the one to keep.
+#define STATE_COMPACT_MAGIC	"MDFNSVCP"
+#define STATE_COMPACT_VERSION	2
+
 static int32_t smem_read(StateMem *st, void *buffer, uint32_t len)
 {
    if ((len + st->loc) > st->len)
@@ -45,6 +53,15 @@ static int32_t smem_write(StateMem *st, void *buffer, uint32_t len)
 {
    if ((len + st->loc) > st->malloced)
    {
+      if (st->fixed)
+      {
+         /* Out of room, keep counting so the caller sees the size needed */
+         st->loc += len;
+         if (st->loc > st->len)
+            st->len = st->loc;
+         return 0;
+      }
+
       uint32_t newsize = (st->malloced >= 32768) ? st->malloced : (st->initial_malloc ? st->initial_malloc : 32768);
 
       while(newsize < (len + st->loc))
@@ -122,12 +139,15 @@ static bool SubWrite(StateMem *st, SFORMAT *sf, const char *name_prefix = NULL)
 
       int32_t bytesize = sf->size;
 
-      char nameo[1 + 256];
-      int slen = snprintf(nameo + 1, 256, "%s%s", name_prefix ? name_prefix : "", sf->name);
-      nameo[0] = slen;
+      if(!st->compact)
+      {
+         char nameo[1 + 256];
+         int slen = snprintf(nameo + 1, 256, "%s%s", name_prefix ? name_prefix : "", sf->name);
+         nameo[0] = slen;
 
-      smem_write(st, nameo, 1 + nameo[0]);
-      smem_write32le(st, bytesize);
+         smem_write(st, nameo, 1 + nameo[0]);
+         smem_write32le(st, bytesize);
+      }
 
 #ifdef MSB_FIRST
       /* Flip the byte order... */
@@ -179,6 +199,65 @@ static bool SubWrite(StateMem *st, SFORMAT *sf, const char *name_prefix = NULL)
    return true;
 }
 
+static void CompactLayoutAdd(StateLayout *layout, SFORMAT *sf)
+{
+   for(; sf->size || sf->name; sf++)
+   {
+      if(!sf->size || !sf->v)
+         continue;
+
+      if(sf->size == (uint32_t)~0)
+      {
+         CompactLayoutAdd(layout, (SFORMAT *)sf->v);
+         continue;
+      }
+
+      /* FNV-1a over the name with its terminator, then the size */
+      const uint8_t *name = (const uint8_t *)sf->name;
+      uint8_t size[4];
+
+      do
+         layout->hash = (layout->hash ^ *name) * 16777619;
+      while(*name++);
+
+      MDFN_en32lsb(size, sf->size);
+      for(int i = 0; i < 4; i++)
+         layout->hash = (layout->hash ^ size[i]) * 16777619;
+
+      layout->size += sf->size;
+   }
+}
+
+/* Layout of a section in the compact format, from the cache of the machine
+ * if there is one.  'scratch' holds it otherwise. */
+static const StateLayout *GetCompactLayout(StateMem *st, const char *sname, SFORMAT *sf, StateLayout *scratch)
+{
+   StateLayouts *layouts = st->layouts;
+   StateLayout *layout = scratch;
+
+   if(layouts)
+   {
+      for(uint32_t i = 0; i < layouts->count; i++)
+      {
+         if(!strncmp(layouts->sections[i].name, sname, 32))
+            return &layouts->sections[i];
+      }
+
+      if(layouts->count < sizeof(layouts->sections) / sizeof(layouts->sections[0]))
+         layout = &layouts->sections[layouts->count++];
+   }
+
+   size_t sname_len = strlen(sname);
+
+   memset(layout->name, 0, sizeof(layout->name));
+   memcpy(layout->name, sname, (sname_len < 32) ? sname_len : 32);
+   layout->hash = 2166136261U;
+   layout->size = 0;
+   CompactLayoutAdd(layout, sf);
+
+   return layout;
+}
+
 static int WriteStateChunk(StateMem *st, const char *sname, SFORMAT *sf)
 {
    int32_t data_start_pos;
@@ -196,6 +275,12 @@ static int WriteStateChunk(StateMem *st, const char *sname, SFORMAT *sf)
 
    data_start_pos = st->loc;
 
+   if(st->compact)
+   {
+      StateLayout scratch;
+      smem_write32le(st, GetCompactLayout(st, sname, sf, &scratch)->hash);
+   }
+
    if(!SubWrite(st, sf))
       return(0);
 
@@ -303,6 +388,59 @@ static int ReadStateChunk(StateMem *st, SFORMAT *sf, int size)
    return 1;
 }
 
+static void ReadCompactFields(StateMem *st, SFORMAT *sf)
+{
+   for(; sf->size || sf->name; sf++)
+   {
+      if(!sf->size || !sf->v)
+         continue;
+
+      if(sf->size == (uint32_t)~0)
+      {
+         ReadCompactFields(st, (SFORMAT *)sf->v);
+         continue;
+      }
+
+      smem_read(st, (uint8_t *)sf->v, sf->size);
+
+      if(sf->flags & MDFNSTATE_BOOL)
+      {
+         for(int32_t bool_monster = sf->size - 1; bool_monster >= 0; bool_monster--)
+            ((bool *)sf->v)[bool_monster] = ((uint8_t *)sf->v)[bool_monster];
+      }
+#ifdef MSB_FIRST
+      else if(sf->flags & MDFNSTATE_RLSB64)
+         Endian_A64_LE_to_NE(sf->v, sf->size / sizeof(uint64_t));
+      else if(sf->flags & MDFNSTATE_RLSB32)
+         Endian_A32_LE_to_NE(sf->v, sf->size / sizeof(uint32_t));
+      else if(sf->flags & MDFNSTATE_RLSB16)
+         Endian_A16_LE_to_NE(sf->v, sf->size / sizeof(uint16_t));
+      else if(sf->flags & RLSB)
+         FlipByteOrder((uint8_t*)sf->v, sf->size);
+#endif
+   }
+}
+
+/* A compact section holds the fields in SFORMAT order with nothing in
+ * between, so it can only be read by the same layout it was written with. */
+static int ReadCompactChunk(StateMem *st, const char *sname, SFORMAT *sf, int size)
+{
+   StateLayout scratch;
+   const StateLayout *layout = GetCompactLayout(st, sname, sf, &scratch);
+   uint32_t hash;
+
+   if((uint32_t)size != 4 + layout->size || st->loc + size > st->len)
+      return(0);
+
+   smem_read32le(st, &hash);
+   if(hash != layout->hash)
+      return(0);
+
+   ReadCompactFields(st, sf);
+
+   return 1;
+}
+
 /* This function is called by the game driver(NES, GB, GBA) to save a state. */
 static int MDFNSS_StateAction_internal(void *st_p, int load, int data_only, SSDescriptor *section)
 {
@@ -326,7 +464,12 @@ static int MDFNSS_StateAction_internal(void *st_p, int load, int data_only, SSDe
          // Yay, we found the section
          if(!strncmp(sname, section->name, 32))
          {
-            if(!ReadStateChunk(st, section->sf, tmp_size))
+            if(st->compact)
+            {
+               if(!ReadCompactChunk(st, section->name, section->sf, tmp_size))
+                  return(0);
+            }
+            else if(!ReadStateChunk(st, section->sf, tmp_size))
                return(0);
             found = 1;
             break;
@@ -371,7 +514,14 @@ int MDFNSS_SaveSM(void *st_p, int, int, const void*, const void*, const void*)
    int neowidth = 0, neoheight = 0;
 
    memset(header, 0, sizeof(header));
-   memcpy(header, header_magic, 8);
+
+   if(st->compact)
+   {
+      memcpy(header, STATE_COMPACT_MAGIC, 8);
+      MDFN_en32lsb(header + 8, STATE_COMPACT_VERSION);
+   }
+   else
+      memcpy(header, header_magic, 8);
 
    MDFN_en32lsb(header + 16, MEDNAFEN_VERSION_NUMERIC);
    MDFN_en32lsb(header + 24, neowidth);
@@ -384,6 +534,10 @@ int MDFNSS_SaveSM(void *st_p, int, int, const void*, const void*, const void*)
    uint32_t sizy = st->loc;
    smem_seek(st, 16 + 4, SEEK_SET);
    smem_write32le(st, sizy);
+   smem_seek(st, sizy, SEEK_SET);
+
+   if(st->fixed && st->len > st->malloced)
+      return(0);
 
    return(1);
 }
@@ -394,9 +548,18 @@ int MDFNSS_LoadSM(void *st_p, int, int)
    uint32_t stateversion;
    StateMem *st = (StateMem*)st_p;
 
-   smem_read(st, header, 32);
+   if(smem_read(st, header, 32) != 32)
+      return(0);
+
+   st->compact = 0;
 
-   if(memcmp(header, "MEDNAFENSVESTATE", 16) && memcmp(header, "MDFNSVST", 8))
+   if(!memcmp(header, STATE_COMPACT_MAGIC, 8))
+   {
+      if(MDFN_de32lsb(header + 8) != STATE_COMPACT_VERSION)
+         return(0);
+      st->compact = 1;
+   }
+   else if(memcmp(header, "MEDNAFENSVESTATE", 16) && memcmp(header, "MDFNSVST", 8))
       return(0);
 
    stateversion = MDFN_de32lsb(header + 16);
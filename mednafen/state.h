@@ -3,6 +3,23 @@
 
 #include <retro_inline.h>
 
+// Layout of a section in compact states, see StateMem::compact
+typedef struct
+{
+   char name[32];
+   uint32_t hash;           // Of the names and sizes of the fields
+   uint32_t size;           // Of the fields, without the hash
+} StateLayout;
+
+// The layouts of the sections of one machine, worked out as they are first
+// used.  They only change with the game loaded, the owner of the machine
+// keeps them and sets 'count' to 0 when the game changes.
+typedef struct
+{
+   StateLayout sections[16];
+   uint32_t count;
+} StateLayouts;
+
 typedef struct
 {
    uint8_t *data;
@@ -10,6 +27,9 @@ typedef struct
    uint32_t len;
    uint32_t malloced;
    uint32_t initial_malloc; // A setting!
+   uint32_t fixed;          // data is a caller buffer of 'malloced' bytes and never grows
+   uint32_t compact;        // Fields are stored at fixed offsets, without names
+   StateLayouts *layouts;   // Compact layouts of the machine, NULL to work them out every time
 } StateMem;
 
 int MDFNSS_SaveSM(void *st, int, int, const void*, const void*, const void*);